@@ -129,10 +129,20 @@ class AddressIndexTest(BitcoinTestFramework):
         assert_equal(len(txidsmany), 4)
         assert_equal(txidsmany[3], sent_txid)
 
+        # Check that txids can be paged through with a cursor
+        print "Testing paged txids..."
+        page = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 2})
+        paged_txids = page["txids"]
+        while page["next"] is not None:
+            page = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 2, "cursor": page["next"]})
+            paged_txids += page["txids"]
+        assert_equal(paged_txids, txidsmany)
+
         # Check that balances are correct
         print "Testing balances..."
         balance0 = self.nodes[1].getaddressbalance("93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB")
         assert_equal(balance0["balance"], 45 * 100000000 + 21)
+        assert_equal(balance0["txcount"], len(txidsmany))
 
         # Check that balances are correct after spending
         print "Testing balances after spending..."
@@ -183,6 +193,17 @@ class AddressIndexTest(BitcoinTestFramework):
         deltasAll = self.nodes[1].getaddressdeltas({"addresses": [address2]})
         assert_equal(len(deltasAll), len(deltas))
 
+        # Check that deltas can be paged through and counted
+        page = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 1})
+        assert_equal(len(page["deltas"]), 1)
+        paged_deltas = page["deltas"]
+        while page["next"] is not None:
+            page = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 1, "cursor": page["next"]})
+            paged_deltas += page["deltas"]
+        assert_equal(paged_deltas, deltasAll)
+        count = self.nodes[1].getaddressdeltas({"addresses": [address2], "countonly": True})
+        assert_equal(count["count"], len(deltasAll))
+
         # Check that deltas can be returned from range of block heights
         deltas = self.nodes[1].getaddressdeltas({"addresses": [address2], "start": 113, "end": 113})
         assert_equal(len(deltas), 1)
@@ -0,0 +1,121 @@
+// Copyright (c) 2017 The Terracoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "coins.h"
+#include "key.h"
+#include "main.h"
+#include "primitives/transaction.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+
+// Script checks as the check queue hands them out in a batch, for
+// comparing RunCheckBatch with running each check on its own.
+static const unsigned int SCRIPT_CHECK_BATCH_SIZE = 128;
+
+class ScriptCheckBatch
+{
+private:
+    std::vector<CCoins> vCoins;
+    std::vector<CTransaction> vTxTo;
+
+public:
+    std::vector<CScriptCheck> vChecks;
+
+    // fMultiSig: spend 2-of-3 multisig outputs with the first and the third
+    // key, otherwise pay-to-pubkey-hash outputs
+    explicit ScriptCheckBatch(bool fMultiSig)
+    {
+        std::vector<CKey> vKeys(3);
+        std::vector<CPubKey> vPubKeys;
+        for (size_t i = 0; i < vKeys.size(); i++) {
+            vKeys[i].MakeNewKey(true);
+            vPubKeys.push_back(vKeys[i].GetPubKey());
+        }
+
+        CScript scriptPubKey;
+        if (fMultiSig) {
+            scriptPubKey = GetScriptForMultisig(2, vPubKeys);
+        } else {
+            scriptPubKey = GetScriptForDestination(vPubKeys[0].GetID());
+        }
+
+        for (unsigned int n = 0; n < SCRIPT_CHECK_BATCH_SIZE; n++) {
+            CMutableTransaction txFrom;
+            txFrom.vin.resize(1);
+            txFrom.vin[0].prevout.n = n;
+            txFrom.vout.resize(1);
+            txFrom.vout[0].nValue = 1;
+            txFrom.vout[0].scriptPubKey = scriptPubKey;
+            vCoins.push_back(CCoins(txFrom, 1));
+
+            CMutableTransaction txTo;
+            txTo.vin.resize(1);
+            txTo.vin[0].prevout = COutPoint(txFrom.GetHash(), 0);
+            txTo.vout.resize(1);
+            txTo.vout[0].nValue = 1;
+
+            uint256 hash = SignatureHash(scriptPubKey, txTo, 0, SIGHASH_ALL);
+            std::vector<unsigned char> vchSig;
+            if (fMultiSig) {
+                txTo.vin[0].scriptSig << OP_0;
+                vKeys[0].Sign(hash, vchSig);
+                vchSig.push_back((unsigned char)SIGHASH_ALL);
+                txTo.vin[0].scriptSig << vchSig;
+                vKeys[2].Sign(hash, vchSig);
+                vchSig.push_back((unsigned char)SIGHASH_ALL);
+                txTo.vin[0].scriptSig << vchSig;
+            } else {
+                vKeys[0].Sign(hash, vchSig);
+                vchSig.push_back((unsigned char)SIGHASH_ALL);
+                txTo.vin[0].scriptSig << vchSig << ToByteVector(vPubKeys[0]);
+            }
+            vTxTo.push_back(txTo);
+        }
+
+        for (unsigned int n = 0; n < SCRIPT_CHECK_BATCH_SIZE; n++) {
+            vChecks.push_back(CScriptCheck(vCoins[n], vTxTo[n], 0, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, false));
+        }
+    }
+};
+
+static void RunChecks(benchmark::State& state, bool fMultiSig, bool fBatch)
+{
+    ScriptCheckBatch checks(fMultiSig);
+    while (state.KeepRunning()) {
+        bool fOk = true;
+        if (fBatch) {
+            fOk = RunCheckBatch(checks.vChecks);
+        } else {
+            for (size_t i = 0; i < checks.vChecks.size() && fOk; i++)
+                fOk = checks.vChecks[i]();
+        }
+        assert(fOk);
+    }
+}
+
+static void VerifyScriptP2PKH(benchmark::State& state)
+{
+    RunChecks(state, false, false);
+}
+
+static void VerifyScriptP2PKHBatch(benchmark::State& state)
+{
+    RunChecks(state, false, true);
+}
+
+static void VerifyScriptMultiSig(benchmark::State& state)
+{
+    RunChecks(state, true, false);
+}
+
+static void VerifyScriptMultiSigBatch(benchmark::State& state)
+{
+    RunChecks(state, true, true);
+}
+
+BENCHMARK(VerifyScriptP2PKH);
+BENCHMARK(VerifyScriptP2PKHBatch);
+BENCHMARK(VerifyScriptMultiSig);
+BENCHMARK(VerifyScriptMultiSigBatch);
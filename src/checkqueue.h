@@ -16,6 +16,21 @@
 template <typename T>
 class CCheckQueueControl;
 
+/**
+ * Run a batch of checks taken off the queue, stopping at the first failure.
+ * Check types that can verify a batch more efficiently than one at a time
+ * can provide a non-template overload for std::vector<T>&, which is found
+ * by argument-dependent lookup.
+ */
+template <typename T>
+bool RunCheckBatch(std::vector<T>& vChecks)
+{
+    BOOST_FOREACH (T& check, vChecks)
+        if (!check())
+            return false;
+    return true;
+}
+
 /** 
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -119,9 +134,8 @@ private:
                 fOk = fAllOk;
             }
             // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
+            if (fOk)
+                fOk = RunCheckBatch(vChecks);
             vChecks.clear();
         } while (true);
     }
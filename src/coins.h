@@ -412,6 +412,22 @@ public:
      */
     bool HaveCoinsInCache(const uint256 &txid) const;
 
+    /**
+     * Look up the given tx in the backing view only, bypassing (and not
+     * filling) this cache. This is used to prefetch entries from several
+     * threads at once, which is only safe if the backing view allows
+     * concurrent reads (as the database view under pcoinsTip does) and
+     * nobody modifies this cache in the meantime.
+     */
+    bool GetCoinsFromBase(const uint256 &txid, CCoins &coins) const;
+
+    /**
+     * Insert an entry that was obtained through GetCoinsFromBase. Entries
+     * that are already cached are left untouched, as they may be newer than
+     * what the backing view returned.
+     */
+    void AddFetchedCoins(const uint256 &txid, CCoins &coins);
+
     /**
      * Return a pointer to CCoins in the cache, or NULL if not found. This is
      * more efficient than GetCoins. Modifications to other cache entries are
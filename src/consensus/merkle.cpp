@@ -1,5 +1,6 @@
 #include "merkle.h"
 #include "hash.h"
+#include "crypto/sha256.h"
 #include "utilstrencodings.h"
 
 /*     WARNING! If you're reading this because you're learning about crypto
@@ -126,10 +127,34 @@ static void MerkleComputation(const std::vector<uint256>& leaves, uint256* proot
     if (proot) *proot = h;
 }
 
+/*
+ * Reduce a list of hashes to its merkle root one level at a time, so that
+ * each level is hashed in a single SHA256D64 batch (which uses the multi-way
+ * SIMD implementations where available). The list is overwritten.
+ * Mutation detection is equivalent to the one in MerkleComputation.
+ */
+static uint256 ComputeMerkleRootInPlace(std::vector<uint256>& hashes, bool* mutated) {
+    bool mutation = false;
+    while (hashes.size() > 1) {
+        if (mutated) {
+            for (size_t pos = 0; pos + 1 < hashes.size(); pos += 2) {
+                if (hashes[pos] == hashes[pos + 1]) mutation = true;
+            }
+        }
+        if (hashes.size() & 1) {
+            hashes.push_back(hashes.back());
+        }
+        SHA256D64(hashes[0].begin(), hashes[0].begin(), hashes.size() / 2);
+        hashes.resize(hashes.size() / 2);
+    }
+    if (mutated) *mutated = mutation;
+    if (hashes.size() == 0) return uint256();
+    return hashes[0];
+}
+
 uint256 ComputeMerkleRoot(const std::vector<uint256>& leaves, bool* mutated) {
-    uint256 hash;
-    MerkleComputation(leaves, &hash, mutated, -1, NULL);
-    return hash;
+    std::vector<uint256> hashes(leaves);
+    return ComputeMerkleRootInPlace(hashes, mutated);
 }
 
 std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position) {
@@ -153,20 +178,17 @@ uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint2
 
 uint256 BlockMerkleRoot(const CBlock& block, bool* mutated)
 {
-    std::vector<uint256> leaves;
-    leaves.resize(block.vtx.size());
-    for (size_t s = 0; s < block.vtx.size(); s++) {
-        leaves[s] = block.vtx[s].GetHash();
+    const std::vector<uint256>& hashes = block.GetTxHashes();
+    if (!block.fMerkleRootCached) {
+        std::vector<uint256> leaves(hashes);
+        block.hashMerkleRootCached = ComputeMerkleRootInPlace(leaves, &block.fMerkleMutatedCached);
+        block.fMerkleRootCached = true;
     }
-    return ComputeMerkleRoot(leaves, mutated);
+    if (mutated) *mutated = block.fMerkleMutatedCached;
+    return block.hashMerkleRootCached;
 }
 
 std::vector<uint256> BlockMerkleBranch(const CBlock& block, uint32_t position)
 {
-    std::vector<uint256> leaves;
-    leaves.resize(block.vtx.size());
-    for (size_t s = 0; s < block.vtx.size(); s++) {
-        leaves[s] = block.vtx[s].GetHash();
-    }
-    return ComputeMerkleBranch(leaves, position);
+    return ComputeMerkleBranch(block.GetTxHashes(), position);
 }
@@ -19,6 +19,7 @@ uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint2
 /*
  * Compute the Merkle root of the transactions in a block.
  * *mutated is set to true if a duplicated subtree was found.
+ * The result is cached in the block until its transactions change.
  */
 uint256 BlockMerkleRoot(const CBlock& block, bool* mutated = NULL);
 
@@ -2474,10 +2474,18 @@ void ThreadCheckDarkSendPool()
 
     unsigned int nTick = 0;
     unsigned int nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN;
+    int64_t nTimeNextTick = GetTimeMillis() + 1000;
 
     while (true)
     {
-        MilliSleep(1000);
+        // wait for the next tick, whole batches of governance votes are processed as soon as
+        // the message handler queues them so that it never has to wait for them itself
+        int64_t nTimeNow;
+        while ((nTimeNow = GetTimeMillis()) < nTimeNextTick) {
+            if (governance.WaitForPendingVoteBatch(nTimeNextTick - nTimeNow))
+                governance.ProcessPendingVotes();
+        }
+        nTimeNextTick = nTimeNow + 1000;
 
         // try to sync from all available nodes, one step at a time
         masternodeSync.ProcessTick();
@@ -2486,6 +2494,10 @@ void ThreadCheckDarkSendPool()
 
             nTick++;
 
+            // process broadcasts and votes which didn't fill a whole batch yet
+            mnodeman.ProcessPendingBroadcasts();
+            governance.ProcessPendingVotes();
+
             // make sure to check all masternodes first
             mnodeman.Check();
 
@@ -2500,10 +2512,6 @@ void ThreadCheckDarkSendPool()
                 mnpayments.CheckAndRemove();
                 instantsend.CheckAndRemove();
             }
-            if(fMasterNode && (nTick % (60 * 5) == 0)) {
-                mnodeman.DoFullVerificationStep();
-            }
-
             if(nTick % (60 * 5) == 0) {
                 governance.DoMaintenance();
             }
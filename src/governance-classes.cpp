@@ -209,6 +209,7 @@ void CGovernanceTriggerManager::CleanAndRemove()
                             LogPrint("gobject", "CGovernanceTriggerManager::CleanAndRemove -- Expiring outdated object: %s\n", pgovobj->GetHash().ToString());
                             pgovobj->fExpired = true;
                             pgovobj->nDeletionTime = GetAdjustedTime();
+                            governance.ScheduleObjectDeletion(*pgovobj);
                         }
                     }
                 }
@@ -327,6 +328,7 @@ bool CSuperblockManager::IsSuperblockTriggered(int nBlockHeight)
         // MAKE SURE THIS TRIGGER IS ACTIVE VIA FUNDING CACHE FLAG
 
         pObj->UpdateSentinelVariables();
+        governance.ScheduleObjectDeletion(*pObj);
 
         if(pObj->IsSetCachedFunding()) {
             LogPrint("gobject", "CSuperblockManager::IsSuperblockTriggered -- fCacheFunding = true, returning true\n");
@@ -13,6 +13,18 @@
 
 #include <univalue.h>
 
+/// Vote tallies are kept for every supported signal and every outcome (including none)
+static const int VOTE_TALLIES_OUTCOMES = VOTE_OUTCOME_ABSTAIN + 1;
+static const int VOTE_TALLIES_SIZE = (MAX_SUPPORTED_VOTE_SIGNAL + 1) * VOTE_TALLIES_OUTCOMES;
+
+/// Position of the (signal, outcome) counter in CGovernanceObject::vecVoteTallies, -1 if it has none
+static int GetVoteTallyIndex(int nSignal, int nOutcome)
+{
+    if(nSignal < 0 || nSignal > MAX_SUPPORTED_VOTE_SIGNAL) return -1;
+    if(nOutcome < 0 || nOutcome >= VOTE_TALLIES_OUTCOMES) return -1;
+    return nSignal * VOTE_TALLIES_OUTCOMES + nOutcome;
+}
+
 CGovernanceObject::CGovernanceObject()
 : cs(),
   nObjectType(GOVERNANCE_OBJECT_UNKNOWN),
@@ -34,6 +46,7 @@ CGovernanceObject::CGovernanceObject()
   fExpired(false),
   fUnparsable(false),
   mapCurrentMNVotes(),
+  vecVoteTallies(VOTE_TALLIES_SIZE, 0),
   mapOrphanVotes(),
   fileVotes()
 {
@@ -62,6 +75,7 @@ CGovernanceObject::CGovernanceObject(uint256 nHashParentIn, int nRevisionIn, int
   fExpired(false),
   fUnparsable(false),
   mapCurrentMNVotes(),
+  vecVoteTallies(VOTE_TALLIES_SIZE, 0),
   mapOrphanVotes(),
   fileVotes()
 {
@@ -90,6 +104,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other)
   fExpired(other.fExpired),
   fUnparsable(other.fUnparsable),
   mapCurrentMNVotes(other.mapCurrentMNVotes),
+  vecVoteTallies(other.vecVoteTallies),
   mapOrphanVotes(other.mapOrphanVotes),
   fileVotes(other.fileVotes)
 {}
@@ -138,6 +153,7 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     vote_instance_m_it it2 = recVote.mapInstances.find(int(eSignal));
     if(it2 == recVote.mapInstances.end()) {
         it2 = recVote.mapInstances.insert(vote_instance_m_t::value_type(int(eSignal), vote_instance_t())).first;
+        UpdateVoteTally(eSignal, it2->second.eOutcome, 1);
     }
     vote_instance_t& voteInstance = it2->second;
 
@@ -187,7 +203,9 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_PERMANENT_ERROR);
         return false;
     }
+    UpdateVoteTally(eSignal, voteInstance.eOutcome, -1);
     voteInstance = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
+    UpdateVoteTally(eSignal, voteInstance.eOutcome, 1);
     if(!fileVotes.HasVote(vote.GetHash())) {
         fileVotes.AddVote(vote);
     }
@@ -208,10 +226,30 @@ void CGovernanceObject::RebuildVoteMap()
         }
     }
     mapCurrentMNVotes = mapMNVotesNew;
+    RebuildVoteTallies();
+}
+
+void CGovernanceObject::UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta)
+{
+    int nIndex = GetVoteTallyIndex(nSignal, eOutcome);
+    if(nIndex < 0) return;
+    vecVoteTallies[nIndex] += nDelta;
+}
+
+void CGovernanceObject::RebuildVoteTallies()
+{
+    vecVoteTallies.assign(VOTE_TALLIES_SIZE, 0);
+    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
+        const vote_instance_m_t& mapInstances = it->second.mapInstances;
+        for(vote_instance_m_cit it2 = mapInstances.begin(); it2 != mapInstances.end(); ++it2) {
+            UpdateVoteTally(it2->first, it2->second.eOutcome, 1);
+        }
+    }
 }
 
 void CGovernanceObject::ClearMasternodeVotes()
 {
+    std::set<CTxIn> setRemovedMasternodes;
     vote_m_it it = mapCurrentMNVotes.begin();
     while(it != mapCurrentMNVotes.end()) {
         bool fIndexRebuilt = false;
@@ -222,17 +260,24 @@ void CGovernanceObject::ClearMasternodeVotes()
                 fRemove = false;
             }
             else {
-                fileVotes.RemoveVotesFromMasternode(vinMasternode);
+                setRemovedMasternodes.insert(vinMasternode);
             }
         }
 
         if(fRemove) {
+            const vote_instance_m_t& mapInstances = it->second.mapInstances;
+            for(vote_instance_m_cit it2 = mapInstances.begin(); it2 != mapInstances.end(); ++it2) {
+                UpdateVoteTally(it2->first, it2->second.eOutcome, -1);
+            }
             mapCurrentMNVotes.erase(it++);
         }
         else {
             ++it;
         }
     }
+
+    // read the votes only once for all masternodes which are gone
+    fileVotes.RemoveVotesFromMasternodes(setRemovedMasternodes);
 }
 
 std::string CGovernanceObject::GetSignatureMessage() const
@@ -634,19 +679,9 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError)
 
 int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const
 {
-    int nCount = 0;
-    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
-        const vote_rec_t& recVote = it->second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if(it2 == recVote.mapInstances.end()) {
-            continue;
-        }
-        const vote_instance_t& voteInstance = it2->second;
-        if(voteInstance.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
-        }
-    }
-    return nCount;
+    int nIndex = GetVoteTallyIndex(eVoteSignalIn, eVoteOutcomeIn);
+    if(nIndex < 0) return 0;
+    return vecVoteTallies[nIndex];
 }
 
 /**
@@ -26,6 +26,7 @@ class CGovernanceVote;
 static const int MAX_GOVERNANCE_OBJECT_DATA_SIZE = 16 * 1024;
 static const int MIN_GOVERNANCE_PEER_PROTO_VERSION = 70206;
 static const int GOVERNANCE_FILTER_PROTO_VERSION = 70206;
+static const int GOVERNANCE_SYNC_SUMMARY_PROTO_VERSION = 70207;
 
 static const double GOVERNANCE_FILTER_FP_RATE = 0.001;
 
@@ -183,6 +184,9 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    /// Number of votes in mapCurrentMNVotes by signal and outcome, see GetVoteTallyIndex()
+    std::vector<int> vecVoteTallies;
+
     /// Limited map of votes orphaned by MN
     vote_mcache_t mapOrphanVotes;
 
@@ -243,6 +247,10 @@ public:
         return fExpired;
     }
 
+    bool HasOrphanVotes() const {
+        return mapOrphanVotes.GetSize() > 0;
+    }
+
     void InvalidateVoteCache() {
         fDirtyCache = true;
     }
@@ -324,6 +332,9 @@ public:
             READWRITE(mapCurrentMNVotes);
             READWRITE(fileVotes);
             LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
+            if(ser_action.ForRead()) {
+                RebuildVoteTallies();
+            }
         }
 
         // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
@@ -346,6 +357,12 @@ private:
 
     void RebuildVoteMap();
 
+    /// Add nDelta to the number of votes with the given signal and outcome
+    void UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta);
+
+    /// Recount vecVoteTallies from mapCurrentMNVotes
+    void RebuildVoteTallies();
+
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
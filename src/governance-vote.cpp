@@ -252,6 +252,22 @@ bool CGovernanceVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     return true;
 }
 
+std::string CGovernanceVote::GetSignatureMessage() const
+{
+    return vinMasternode.prevout.ToStringShort() + "|" + nParentHash.ToString() + "|" +
+        boost::lexical_cast<std::string>(nVoteSignal) + "|" + boost::lexical_cast<std::string>(nVoteOutcome) + "|" + boost::lexical_cast<std::string>(nTime);
+}
+
+bool CGovernanceVote::GetSignatureCheck(CMasternodeSignatureCheck& checkRet) const
+{
+    masternode_info_t infoMn = mnodeman.GetMasternodeInfo(vinMasternode);
+    if(!infoMn.fInfoValid) {
+        return false;
+    }
+    checkRet = CMasternodeSignatureCheck(infoMn.pubKeyMasternode, vchSig, GetSignatureMessage());
+    return true;
+}
+
 bool CGovernanceVote::IsValid(bool fSignatureCheck) const
 {
     if(nTime > GetTime() + (60*60)) {
@@ -282,10 +298,9 @@ bool CGovernanceVote::IsValid(bool fSignatureCheck) const
     if(!fSignatureCheck) return true;
 
     std::string strError;
-    std::string strMessage = vinMasternode.prevout.ToStringShort() + "|" + nParentHash.ToString() + "|" +
-        boost::lexical_cast<std::string>(nVoteSignal) + "|" + boost::lexical_cast<std::string>(nVoteOutcome) + "|" + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
-    if(!darkSendSigner.VerifyMessage(infoMn.pubKeyMasternode, vchSig, strMessage, strError)) {
+    if(!CMasternodeSignatureCheck::Verify(infoMn.pubKeyMasternode, vchSig, strMessage, strError)) {
         LogPrintf("CGovernanceVote::IsValid -- VerifyMessage() failed, error: %s\n", strError);
         return false;
     }
@@ -13,6 +13,7 @@
 using namespace std;
 
 class CGovernanceVote;
+class CMasternodeSignatureCheck;
 
 // INTENTION OF MASTERNODES REGARDING ITEM
 enum vote_outcome_enum_t  {
@@ -121,6 +122,9 @@ public:
     void SetSignature(const std::vector<unsigned char>& vchSigIn) { vchSig = vchSigIn; }
 
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
+    std::string GetSignatureMessage() const;
+    /// Prepare the verification of the signature ahead of IsValid, returns false if the masternode is unknown
+    bool GetSignatureCheck(CMasternodeSignatureCheck& checkRet) const;
     bool IsValid(bool fSignatureCheck) const;
     void Relay() const;
 
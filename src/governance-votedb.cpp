@@ -3,94 +3,222 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "governance-votedb.h"
+#include "hash.h"
+#include "util.h"
 
-CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
-    : nMemoryVotes(0),
-      listVotes(),
-      mapVoteIndex()
+#include <boost/scoped_ptr.hpp>
+
+static const char DB_GOVERNANCE_VOTE = 'v';
+
+CGovernanceVoteDB* pgovernancevotedb = NULL;
+
+CGovernanceVoteDB::CGovernanceVoteDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CDBWrapper(GetDataDir() / "govvotes", nCacheSize, fMemory, fWipe),
+      cs(),
+      mapRecentVotes(MAX_CACHED_VOTES)
 {}
 
-CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other)
-    : nMemoryVotes(other.nMemoryVotes),
-      listVotes(other.listVotes),
-      mapVoteIndex()
+bool CGovernanceVoteDB::WriteVote(const CGovernanceVote& vote)
 {
-    RebuildIndex();
+    LOCK(cs);
+    uint256 nVoteHash = vote.GetHash();
+    mapRecentVotes.Insert(nVoteHash, vote);
+    return Write(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(vote.GetParentHash(), nVoteHash)), vote);
 }
 
-void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
+bool CGovernanceVoteDB::ReadVote(const uint256& nParentHash, const uint256& nVoteHash, CGovernanceVote& vote)
+{
+    LOCK(cs);
+    if(mapRecentVotes.Get(nVoteHash, vote)) {
+        return true;
+    }
+    if(!Read(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nVoteHash)), vote)) {
+        return false;
+    }
+    mapRecentVotes.Insert(nVoteHash, vote);
+    return true;
+}
+
+bool CGovernanceVoteDB::EraseVote(const uint256& nParentHash, const uint256& nVoteHash)
 {
-    listVotes.push_front(vote);
-    mapVoteIndex[vote.GetHash()] = listVotes.begin();
-    ++nMemoryVotes;
+    LOCK(cs);
+    mapRecentVotes.Erase(nVoteHash);
+    return Erase(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nVoteHash)));
 }
 
-bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
+bool CGovernanceVoteDB::EraseVotes(const uint256& nParentHash, const std::vector<uint256>& vecVoteHashes)
 {
-    vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
-        return false;
+    LOCK(cs);
+
+    CDBBatch batch(&GetObfuscateKey());
+    for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+        mapRecentVotes.Erase(vecVoteHashes[i]);
+        batch.Erase(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, vecVoteHashes[i])));
+    }
+
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotes)
+{
+    LOCK(cs);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, uint256())));
+
+    while(pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if(!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_VOTE || key.second.first != nParentHash) break;
+        CGovernanceVote vote;
+        if(!pcursor->GetValue(vote)) {
+            return error("%s: failed to read vote %s", __func__, key.second.second.ToString());
+        }
+        vecVotes.push_back(vote);
+        pcursor->Next();
     }
+
     return true;
 }
 
+bool CGovernanceVoteDB::EraseVotes(const uint256& nParentHash)
+{
+    LOCK(cs);
+
+    CDBBatch batch(&GetObfuscateKey());
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, uint256())));
+
+    while(pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if(!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_VOTE || key.second.first != nParentHash) break;
+        mapRecentVotes.Erase(key.second.second);
+        batch.Erase(key);
+        pcursor->Next();
+    }
+
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::EraseVotesExcept(const std::set<uint256>& setKeep, std::set<uint256>& setStoredRet, int& nErasedRet)
+{
+    LOCK(cs);
+
+    nErasedRet = 0;
+    CDBBatch batch(&GetObfuscateKey());
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(DB_GOVERNANCE_VOTE);
+
+    while(pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if(!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_VOTE) break;
+        if(setKeep.count(key.second.second)) {
+            setStoredRet.insert(key.second.second);
+        }
+        else {
+            mapRecentVotes.Erase(key.second.second);
+            batch.Erase(key);
+            ++nErasedRet;
+        }
+        pcursor->Next();
+    }
+
+    return WriteBatch(batch);
+}
+
+CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
+    : nParentHash(),
+      setVoteHashes(),
+      nLastVoteTime(0)
+{}
+
+void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
+{
+    nParentHash = vote.GetParentHash();
+    setVoteHashes.insert(vote.GetHash());
+    nLastVoteTime = std::max(nLastVoteTime, vote.GetTimestamp());
+    pgovernancevotedb->WriteVote(vote);
+}
+
+bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
+{
+    return setVoteHashes.count(nHash);
+}
+
 bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& vote) const
 {
-    vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
+    if(!setVoteHashes.count(nHash)) {
         return false;
     }
-    vote = *(it->second);
-    return true;
+    return pgovernancevotedb->ReadVote(nParentHash, nHash, vote);
 }
 
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 {
     std::vector<CGovernanceVote> vecResult;
-    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
-        vecResult.push_back(*it);
+    if(setVoteHashes.empty()) {
+        return vecResult;
+    }
+
+    std::vector<CGovernanceVote> vecVotes;
+    pgovernancevotedb->ReadVotes(nParentHash, vecVotes);
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        if(setVoteHashes.count(vecVotes[i].GetHash())) {
+            vecResult.push_back(vecVotes[i]);
+        }
     }
     return vecResult;
 }
 
-void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const CTxIn& vinMasternode)
+uint256 CGovernanceObjectVoteFile::GetVoteSetHash(const std::set<uint256>& setHashes)
 {
-    vote_l_it it = listVotes.begin();
-    while(it != listVotes.end()) {
-        if(it->GetVinMasternode() == vinMasternode) {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
-        }
-        else {
-            ++it;
-        }
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    for(std::set<uint256>::const_iterator it = setHashes.begin(); it != setHashes.end(); ++it) {
+        ss << *it;
     }
+    return ss.GetHash();
 }
 
-CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
+void CGovernanceObjectVoteFile::RemoveVotesFromMasternodes(const std::set<CTxIn>& setMasternodes)
 {
-    nMemoryVotes = other.nMemoryVotes;
-    listVotes = other.listVotes;
-    RebuildIndex();
-    return *this;
+    if(setMasternodes.empty()) {
+        return;
+    }
+
+    std::vector<uint256> vecRemoved;
+    std::vector<CGovernanceVote> vecVotes = GetVotes();
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        if(setMasternodes.count(vecVotes[i].GetVinMasternode())) {
+            uint256 nHash = vecVotes[i].GetHash();
+            setVoteHashes.erase(nHash);
+            vecRemoved.push_back(nHash);
+        }
+    }
+
+    if(!vecRemoved.empty()) {
+        pgovernancevotedb->EraseVotes(nParentHash, vecRemoved);
+    }
 }
 
-void CGovernanceObjectVoteFile::RebuildIndex()
+int CGovernanceObjectVoteFile::RemoveMissingVotes(const std::set<uint256>& setStored)
 {
-    mapVoteIndex.clear();
-    nMemoryVotes = 0;
-    vote_l_it it = listVotes.begin();
-    while(it != listVotes.end()) {
-        CGovernanceVote& vote = *it;
-        uint256 nHash = vote.GetHash();
-        if(mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
-            mapVoteIndex[nHash] = it;
-            ++nMemoryVotes;
+    int nRemoved = 0;
+    std::set<uint256>::iterator it = setVoteHashes.begin();
+    while(it != setVoteHashes.end()) {
+        if(setStored.count(*it)) {
             ++it;
+            continue;
         }
-        else {
-            listVotes.erase(it++);
-        }
+        setVoteHashes.erase(it++);
+        ++nRemoved;
+    }
+    return nRemoved;
+}
+
+void CGovernanceObjectVoteFile::RemoveAllVotes()
+{
+    if(!setVoteHashes.empty()) {
+        pgovernancevotedb->EraseVotes(nParentHash);
     }
+    setVoteHashes.clear();
+    nLastVoteTime = 0;
 }
@@ -5,89 +5,147 @@
 #ifndef GOVERNANCE_VOTEDB_H
 #define GOVERNANCE_VOTEDB_H
 
-#include <list>
-#include <map>
+#include <set>
+#include <vector>
 
+#include "cachemap.h"
+#include "dbwrapper.h"
 #include "governance-vote.h"
 #include "serialize.h"
+#include "sync.h"
 #include "uint256.h"
 
+class CGovernanceVoteDB;
+
+extern CGovernanceVoteDB* pgovernancevotedb;
+
+/** -dbcache share of the governance vote database is fixed, votes are small and rarely read */
+static const size_t GOVERNANCE_VOTE_DB_CACHE_SIZE = 1 << 22;
+
 /**
- * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
+ * Access to the governance vote database (govvotes/)
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Votes are stored by parent object hash and vote hash, so that all votes
+ * for an object can be read or erased with a single cursor.
+ * Recently written or read votes are kept in memory.
  */
-class CGovernanceObjectVoteFile
+class CGovernanceVoteDB : public CDBWrapper
 {
-public: // Types
-    typedef std::list<CGovernanceVote> vote_l_t;
-
-    typedef vote_l_t::iterator vote_l_it;
+private:
+    static const int MAX_CACHED_VOTES = 1000;
 
-    typedef vote_l_t::const_iterator vote_l_cit;
+    CCriticalSection cs;
 
-    typedef std::map<uint256,vote_l_it> vote_m_t;
+    CacheMap<uint256, CGovernanceVote> mapRecentVotes;
 
-    typedef vote_m_t::iterator vote_m_it;
+    CGovernanceVoteDB(const CGovernanceVoteDB&);
+    void operator=(const CGovernanceVoteDB&);
 
-    typedef vote_m_t::const_iterator vote_m_cit;
+public:
+    CGovernanceVoteDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool WriteVote(const CGovernanceVote& vote);
+    bool ReadVote(const uint256& nParentHash, const uint256& nVoteHash, CGovernanceVote& vote);
+    bool EraseVote(const uint256& nParentHash, const uint256& nVoteHash);
+    /// Erase the votes vecVoteHashes for the object nParentHash in a single batch
+    bool EraseVotes(const uint256& nParentHash, const std::vector<uint256>& vecVoteHashes);
+
+    /// Read all votes for the object nParentHash
+    bool ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotes);
+    /// Erase all votes for the object nParentHash
+    bool EraseVotes(const uint256& nParentHash);
+    /**
+     * Erase all votes whose hash is not in setKeep, the hashes of the votes
+     * which are kept are returned in setStoredRet
+     */
+    bool EraseVotesExcept(const std::set<uint256>& setKeep, std::set<uint256>& setStoredRet, int& nErasedRet);
+};
 
+/**
+ * Represents the collection of votes associated with a given CGovernanceObject
+ *
+ * Only the hashes of the votes are held in memory (and serialized along with
+ * the object), the votes themselves are stored in pgovernancevotedb.
+ */
+class CGovernanceObjectVoteFile
+{
 private:
-    static const int MAX_MEMORY_VOTES = -1;
-
-    int nMemoryVotes;
+    /// Hash of the object these votes are for, known once the first vote was added
+    uint256 nParentHash;
 
-    vote_l_t listVotes;
+    std::set<uint256> setVoteHashes;
 
-    vote_m_t mapVoteIndex;
+    /// Timestamp of the newest vote added to the file
+    int64_t nLastVoteTime;
 
 public:
     CGovernanceObjectVoteFile();
 
-    CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other);
-
     /**
      * Add a vote to the file
      */
     void AddVote(const CGovernanceVote& vote);
 
     /**
-     * Return true if the vote with this hash is currently cached in memory
+     * Return true if the vote with this hash is in the file
      */
     bool HasVote(const uint256& nHash) const;
 
     /**
-     * Retrieve a vote cached in memory
+     * Retrieve a vote from the database
      */
     bool GetVote(const uint256& nHash, CGovernanceVote& vote) const;
 
-    int GetVoteCount() {
-        return nMemoryVotes;
+    int GetVoteCount() const {
+        return (int)setVoteHashes.size();
     }
 
+    const std::set<uint256>& GetVoteHashes() const {
+        return setVoteHashes;
+    }
+
+    int64_t GetLastVoteTime() const {
+        return nLastVoteTime;
+    }
+
+    /**
+     * Hash of the vote hashes in the file, equal for files holding the same votes
+     */
+    uint256 GetVoteSetHash() const {
+        return GetVoteSetHash(setVoteHashes);
+    }
+
+    static uint256 GetVoteSetHash(const std::set<uint256>& setHashes);
+
+    /**
+     * Retrieve all votes from the database
+     */
     std::vector<CGovernanceVote> GetVotes() const;
 
-    CGovernanceObjectVoteFile& operator=(const CGovernanceObjectVoteFile& other);
+    /**
+     * Remove the votes of all masternodes in setMasternodes, the votes are read only once
+     */
+    void RemoveVotesFromMasternodes(const std::set<CTxIn>& setMasternodes);
 
-    void RemoveVotesFromMasternode(const CTxIn& vinMasternode);
+    /**
+     * Forget votes which are not in the database (anymore), returns the number of votes removed
+     */
+    int RemoveMissingVotes(const std::set<uint256>& setStored);
+
+    /**
+     * Erase all votes from the database, when the object is removed
+     */
+    void RemoveAllVotes();
 
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        READWRITE(nMemoryVotes);
-        READWRITE(listVotes);
-        if(ser_action.ForRead()) {
-            RebuildIndex();
-        }
+        READWRITE(nParentHash);
+        READWRITE(setVoteHashes);
+        READWRITE(nLastVoteTime);
     }
-private:
-    void RebuildIndex();
-
 };
 
 #endif
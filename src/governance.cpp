@@ -18,7 +18,7 @@ CGovernanceManager governance;
 
 int nSubmittedFinalBudget;
 
-const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-11";
+const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-13";
 
 CGovernanceManager::CGovernanceManager()
     : pCurrentBlockIndex(NULL),
@@ -36,6 +36,12 @@ CGovernanceManager::CGovernanceManager()
       mapLastMasternodeObject(),
       setRequestedObjects(),
       fRateChecksEnabled(true),
+      setDirtyObjects(),
+      setObjectsWithOrphanVotes(),
+      wheelWatchdogs(),
+      wheelDeletions(),
+      wheelOrphanVotes(),
+      fVoteBatchReady(false),
       cs()
 {}
 
@@ -146,6 +152,81 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
     }
 
+    // ANOTHER USER IS ASKING US FOR THE VOTES IT MISSES
+    else if (strCommand == NetMsgType::MNGOVERNANCESYNCSUMMARY)
+    {
+        // Ignore such requests until we are fully synced, same as MNGOVERNANCESYNC
+        if (!masternodeSync.IsSynced()) return;
+
+        std::vector<CGovernanceObjectVoteSummary> vecSummary;
+        vRecv >> vecSummary;
+
+        if(vecSummary.size() > MAX_SYNC_SUMMARY_SIZE) {
+            LogPrint("gobject", "MNGOVERNANCESYNCSUMMARY -- too many objects in summary: %d, peer=%d\n", vecSummary.size(), pfrom->id);
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        // Each summary makes us look up every listed object. Peers follow up with the objects
+        // they received later, so limit the number of objects per period instead of the messages.
+        {
+            LOCK(cs);
+            int64_t nNow = GetTime();
+            std::pair<int64_t, size_t>& objectsReceived = mapSummaryObjectsReceived[pfrom->addr];
+            if(objectsReceived.first < nNow) {
+                objectsReceived = std::make_pair(nNow + SYNC_SUMMARY_PERIOD, size_t(0));
+            }
+            if(objectsReceived.second + vecSummary.size() > MAX_SYNC_SUMMARY_SIZE) {
+                LogPrint("gobject", "MNGOVERNANCESYNCSUMMARY -- peer summarized too many objects already: %d, peer=%d\n", objectsReceived.second, pfrom->id);
+                return;
+            }
+            objectsReceived.second += vecSummary.size();
+        }
+
+        SyncVoteDeltas(pfrom, vecSummary);
+    }
+
+    // A BATCH OF VOTES WE ASKED FOR WITH MNGOVERNANCESYNCSUMMARY HAS ARRIVED
+    else if (strCommand == NetMsgType::MNGOVERNANCEVOTES)
+    {
+        // Ignore such messages until masternode list is synced
+        if(!masternodeSync.IsMasternodeListSynced()) {
+            LogPrint("gobject", "MNGOVERNANCEVOTES -- masternode list not synced\n");
+            return;
+        }
+
+        if(!netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::MNGOVERNANCESYNCSUMMARY)) {
+            LogPrint("gobject", "MNGOVERNANCEVOTES -- Received unrequested votes, peer=%d\n", pfrom->id);
+            return;
+        }
+
+        std::vector<CGovernanceVote> vecVotes;
+        vRecv >> vecVotes;
+
+        if(vecVotes.size() > MAX_VOTE_BATCH_SIZE) {
+            LogPrint("gobject", "MNGOVERNANCEVOTES -- too many votes in batch: %d, peer=%d\n", vecVotes.size(), pfrom->id);
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        // queue the votes behind the ones already pending, the DarkSend pool thread verifies
+        // and processes them in the order they arrived, the message handler must not wait for it
+        {
+            LOCK(cs);
+            for(size_t i = 0; i < vecVotes.size(); ++i) {
+                pfrom->AddRef();
+                vecPendingVotes.push_back(std::make_pair(pfrom, vecVotes[i]));
+            }
+        }
+        {
+            boost::unique_lock<boost::mutex> lock(cs_votebatchready);
+            fVoteBatchReady = true;
+            cvVoteBatchReady.notify_one();
+        }
+
+        LogPrint("gobject", "MNGOVERNANCEVOTES -- queued %d votes, peer=%d\n", vecVotes.size(), pfrom->id);
+    }
+
     // A NEW GOVERNANCE OBJECT HAS ARRIVED
     else if (strCommand == NetMsgType::MNGOVERNANCEOBJECT)
 
@@ -267,21 +348,99 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             return;
         }
 
-        CGovernanceException exception;
-        if(ProcessVote(pfrom, vote, exception)) {
-            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
-            masternodeSync.AddedGovernanceItem();
-            vote.Relay();
-        }
-        else {
-            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
-            if((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
-                Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
+        // votes come in bursts, verify their signatures in batches on the signature check threads
+        if(nScriptCheckThreads) {
+            {
+                LOCK(cs);
+                pfrom->AddRef();
+                vecPendingVotes.push_back(std::make_pair(pfrom, vote));
+                if(vecPendingVotes.size() < VOTE_VERIFY_BATCH_SIZE) return;
             }
+            // the DarkSend pool thread flushes the batch, the message handler must not wait for it
+            boost::unique_lock<boost::mutex> lock(cs_votebatchready);
+            fVoteBatchReady = true;
+            cvVoteBatchReady.notify_one();
             return;
         }
 
+        ProcessReceivedVote(pfrom, vote);
+    }
+}
+
+void CGovernanceManager::ProcessReceivedVote(CNode* pfrom, const CGovernanceVote& vote)
+{
+    CGovernanceException exception;
+    if(ProcessVote(pfrom, vote, exception)) {
+        LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", vote.GetHash().ToString());
+        masternodeSync.AddedGovernanceItem();
+        vote.Relay();
+    }
+    else {
+        LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
+        if((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
+        }
+    }
+}
+
+void CGovernanceManager::PrepareSignatureCheck(const CGovernanceVote& vote, std::vector<CMasternodeSignatureCheck>& vChecks)
+{
+    if(HaveVoteForHash(vote.GetHash())) {
+        return;
+    }
+    CMasternodeSignatureCheck check;
+    if(vote.GetSignatureCheck(check)) {
+        vChecks.push_back(check);
+    }
+}
+
+void CGovernanceManager::ProcessPendingVotes()
+{
+    LOCK(cs_pendingvotes);
+
+    std::vector<std::pair<CNode*, CGovernanceVote> > vecVotes;
+    {
+        LOCK(cs);
+        vecVotes.swap(vecPendingVotes);
+    }
+    if(vecVotes.empty()) return;
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    // verify all signatures of the batch at once on the signature check threads ...
+    std::vector<CMasternodeSignatureCheck> vChecks;
+    vChecks.reserve(vecVotes.size());
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        PrepareSignatureCheck(vecVotes[i].second, vChecks);
+    }
+    VerifyMasternodeSignatures(vChecks);
+
+    int64_t nTimeVerified = GetTimeMicros();
+
+    // ... then process them one by one in the order they arrived, their signature checks are cached now
+    // votes synced in govvotes batches may include ones we have already
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        if(!HaveVoteForHash(vecVotes[i].second.GetHash())) {
+            ProcessReceivedVote(vecVotes[i].first, vecVotes[i].second);
+        }
+        vecVotes[i].first->Release();
     }
+
+    LogPrint("gobject", "CGovernanceManager::ProcessPendingVotes -- %d votes, verified in %.2fms, processed in %.2fms\n",
+              vecVotes.size(), 0.001 * (nTimeVerified - nTimeStart), 0.001 * (GetTimeMicros() - nTimeVerified));
+}
+
+bool CGovernanceManager::WaitForPendingVoteBatch(int64_t nTimeoutMillis)
+{
+    boost::system_time timeout = boost::get_system_time() + boost::posix_time::milliseconds(nTimeoutMillis);
+    boost::unique_lock<boost::mutex> lock(cs_votebatchready);
+    while(!fVoteBatchReady) {
+        if(!cvVoteBatchReady.timed_wait(lock, timeout)) break;
+    }
+    bool fReady = fVoteBatchReady;
+    fVoteBatchReady = false;
+    return fReady;
 }
 
 void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernanceException& exception)
@@ -308,6 +467,12 @@ void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernance
             mapOrphanVotes.Erase(nHash, pairVote);
         }
     }
+    if(govobj.IsSetDirtyCache()) {
+        setDirtyObjects.insert(nHash);
+    }
+    if(govobj.HasOrphanVotes()) {
+        setObjectsWithOrphanVotes.insert(nHash);
+    }
     fRateChecksEnabled = true;
 }
 
@@ -361,6 +526,7 @@ bool CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, bool& fA
 
     // INSERT INTO OUR GOVERNANCE OBJECT MEMORY
     mapObjects.insert(std::make_pair(nHash, govobj));
+    setDirtyObjects.insert(nHash);
 
     // SHOULD WE ADD THIS OBJECT TO ANY OTHER MANANGERS?
 
@@ -377,6 +543,7 @@ bool CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, bool& fA
         break;
     case GOVERNANCE_OBJECT_WATCHDOG:
         mapWatchdogObjects[nHash] = govobj.GetCreationTime() + GOVERNANCE_WATCHDOG_EXPIRATION_TIME;
+        wheelWatchdogs.Schedule(nHash, mapWatchdogObjects[nHash]);
         LogPrint("gobject", "CGovernanceManager::AddGovernanceObject -- Added watchdog to map: hash = %s\n", nHash.ToString());
         break;
     default:
@@ -411,6 +578,7 @@ bool CGovernanceManager::UpdateCurrentWatchdog(CGovernanceObject& watchdogNew)
             if(it->second.nDeletionTime == 0) {
                 it->second.nDeletionTime = nNow;
             }
+            ScheduleObjectDeletion(it->second);
         }
         nHashWatchdogCurrent = watchdogNew.GetHash();
         nTimeWatchdogCurrent = watchdogNew.GetCreationTime();
@@ -430,32 +598,47 @@ void CGovernanceManager::UpdateCachesAndClean()
 
     LOCK(cs);
 
+    // Forget the summary limits of peers whose period is over
+    int64_t nTimeNow = GetTime();
+    std::map<CNetAddr, std::pair<int64_t, size_t> >::iterator itSummary = mapSummaryObjectsReceived.begin();
+    while(itSummary != mapSummaryObjectsReceived.end()) {
+        if(itSummary->second.first < nTimeNow) {
+            mapSummaryObjectsReceived.erase(itSummary++);
+        } else {
+            ++itSummary;
+        }
+    }
+
     // Flag expired watchdogs for removal
     int64_t nNow = GetAdjustedTime();
-    LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Number watchdogs in map: %d, current time = %d\n", mapWatchdogObjects.size(), nNow);
-    if(mapWatchdogObjects.size() > 1) {
-        hash_time_m_it it = mapWatchdogObjects.begin();
-        while(it != mapWatchdogObjects.end()) {
-            LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Checking watchdog: %s, expiration time = %d\n", it->first.ToString(), it->second);
-            if(it->second < nNow) {
-                LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Attempting to expire watchdog: %s, expiration time = %d\n", it->first.ToString(), it->second);
-                object_m_it it2 = mapObjects.find(it->first);
-                if(it2 != mapObjects.end()) {
-                    LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Expiring watchdog: %s, expiration time = %d\n", it->first.ToString(), it->second);
-                    it2->second.fExpired = true;
-                    if(it2->second.nDeletionTime == 0) {
-                        it2->second.nDeletionTime = nNow;
-                    }
-                }
-                if(it->first == nHashWatchdogCurrent) {
-                    nHashWatchdogCurrent = uint256();
-                }
-                mapWatchdogObjects.erase(it++);
-            }
-            else {
-                ++it;
+    std::vector<uint256> vecDue;
+    wheelWatchdogs.Advance(nNow, vecDue);
+    LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Number watchdogs in map: %d, expired: %d, current time = %d\n", mapWatchdogObjects.size(), vecDue.size(), nNow);
+    // the last watchdog is kept until a new one arrives
+    bool fExpireWatchdogs = mapWatchdogObjects.size() > 1;
+    for(size_t i = 0; i < vecDue.size(); ++i) {
+        hash_time_m_it it = mapWatchdogObjects.find(vecDue[i]);
+        if(it == mapWatchdogObjects.end()) {
+            continue;
+        }
+        if(!fExpireWatchdogs) {
+            wheelWatchdogs.Schedule(it->first, it->second);
+            continue;
+        }
+        LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Attempting to expire watchdog: %s, expiration time = %d\n", it->first.ToString(), it->second);
+        object_m_it it2 = mapObjects.find(it->first);
+        if(it2 != mapObjects.end()) {
+            LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Expiring watchdog: %s, expiration time = %d\n", it->first.ToString(), it->second);
+            it2->second.fExpired = true;
+            if(it2->second.nDeletionTime == 0) {
+                it2->second.nDeletionTime = nNow;
             }
+            ScheduleObjectDeletion(it2->second);
         }
+        if(it->first == nHashWatchdogCurrent) {
+            nHashWatchdogCurrent = uint256();
+        }
+        mapWatchdogObjects.erase(it);
     }
 
     for(size_t i = 0; i < vecDirtyHashes.size(); ++i) {
@@ -463,8 +646,17 @@ void CGovernanceManager::UpdateCachesAndClean()
         if(it == mapObjects.end()) {
             continue;
         }
+        // drop references to the votes removed along with their masternodes
+        std::set<uint256> setVoteHashesBefore = it->second.GetVoteFile().GetVoteHashes();
         it->second.ClearMasternodeVotes();
+        const std::set<uint256>& setVoteHashesAfter = it->second.GetVoteFile().GetVoteHashes();
+        for(std::set<uint256>::const_iterator it2 = setVoteHashesBefore.begin(); it2 != setVoteHashesBefore.end(); ++it2) {
+            if(!setVoteHashesAfter.count(*it2)) {
+                mapVoteToObject.Erase(*it2);
+            }
+        }
         it->second.fDirtyCache = true;
+        setDirtyObjects.insert(it->first);
     }
 
     // DOUBLE CHECK THAT WE HAVE A VALID POINTER TO TIP
@@ -475,75 +667,88 @@ void CGovernanceManager::UpdateCachesAndClean()
 
     LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- After pCurrentBlockIndex (not NULL)\n");
 
-    // UPDATE CACHE FOR EACH OBJECT THAT IS FLAGGED DIRTYCACHE=TRUE
-
-    object_m_it it = mapObjects.begin();
-
     // Clean up any expired or invalid triggers
     triggerman.CleanAndRemove();
 
-    while(it != mapObjects.end())
-    {
-        CGovernanceObject* pObj = &((*it).second);
+    // UPDATE CACHE FOR EACH OBJECT THAT IS FLAGGED DIRTYCACHE=TRUE
 
-        if(!pObj) {
-            ++it;
+    for(hash_s_it it = setDirtyObjects.begin(); it != setDirtyObjects.end(); ++it) {
+        object_m_it itObj = mapObjects.find(*it);
+        if(itObj == mapObjects.end()) {
             continue;
         }
+        CGovernanceObject& govobj = itObj->second;
 
-        uint256 nHash = it->first;
-        std::string strHash = nHash.ToString();
-
-        // IF CACHE IS NOT DIRTY, WHY DO THIS?
-        if(pObj->IsSetDirtyCache()) {
+        if(govobj.IsSetDirtyCache()) {
             // UPDATE LOCAL VALIDITY AGAINST CRYPTO DATA
-            pObj->UpdateLocalValidity();
+            govobj.UpdateLocalValidity();
 
             // UPDATE SENTINEL SIGNALING VARIABLES
-            pObj->UpdateSentinelVariables();
+            govobj.UpdateSentinelVariables();
         }
 
-        if(pObj->IsSetCachedDelete() && (nHash == nHashWatchdogCurrent)) {
+        if(govobj.IsSetCachedDelete() && (*it == nHashWatchdogCurrent)) {
             nHashWatchdogCurrent = uint256();
         }
 
-        // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
+        ScheduleObjectDeletion(govobj);
+    }
+    setDirtyObjects.clear();
 
-        int64_t nTimeSinceDeletion = GetAdjustedTime() - pObj->GetDeletionTime();
+    // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
 
-        LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Checking object for deletion: %s, deletion time = %d, time since deletion = %d, delete flag = %d, expired flag = %d\n",
-                 strHash, pObj->GetDeletionTime(), nTimeSinceDeletion, pObj->IsSetCachedDelete(), pObj->IsSetExpired());
+    vecDue.clear();
+    wheelDeletions.Advance(nNow, vecDue);
 
-        if((pObj->IsSetCachedDelete() || pObj->IsSetExpired()) &&
-           (nTimeSinceDeletion >= GOVERNANCE_DELETION_DELAY)) {
-            LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", (*it).first.ToString());
-            mnodeman.RemoveGovernanceObject(pObj->GetHash());
+    for(size_t i = 0; i < vecDue.size(); ++i) {
+        object_m_it it = mapObjects.find(vecDue[i]);
+        if(it == mapObjects.end()) {
+            continue;
+        }
+        CGovernanceObject& govobj = it->second;
 
-            // Remove vote references
-            const object_ref_cache_t::list_t& listItems = mapVoteToObject.GetItemList();
-            object_ref_cache_t::list_cit lit = listItems.begin();
-            while(lit != listItems.end()) {
-                if(lit->value == pObj) {
-                    uint256 nKey = lit->key;
-                    ++lit;
-                    mapVoteToObject.Erase(nKey);
-                }
-                else {
-                    ++lit;
-                }
-            }
-            if(pObj->nObjectType == GOVERNANCE_OBJECT_WATCHDOG) {
-                mapWatchdogObjects.erase(it->first);
-            }
-            mapObjects.erase(it++);
-        } else {
-            ++it;
+        if(!govobj.IsSetCachedDelete() && !govobj.IsSetExpired()) {
+            continue;
+        }
+
+        int64_t nTimeSinceDeletion = nNow - govobj.GetDeletionTime();
+        if(nTimeSinceDeletion < GOVERNANCE_DELETION_DELAY) {
+            // deletion time was moved since it was scheduled
+            ScheduleObjectDeletion(govobj);
+            continue;
+        }
+
+        LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", it->first.ToString());
+        mnodeman.RemoveGovernanceObject(it->first);
+
+        // Remove vote references
+        const std::set<uint256>& setVoteHashes = govobj.GetVoteFile().GetVoteHashes();
+        for(std::set<uint256>::const_iterator it2 = setVoteHashes.begin(); it2 != setVoteHashes.end(); ++it2) {
+            mapVoteToObject.Erase(*it2);
+        }
+        if(govobj.nObjectType == GOVERNANCE_OBJECT_WATCHDOG) {
+            mapWatchdogObjects.erase(it->first);
+            wheelWatchdogs.Cancel(it->first);
         }
+        govobj.GetVoteFile().RemoveAllVotes();
+        mapAskedRecently.erase(it->first);
+        mapObjects.erase(it);
     }
 
     fRateChecksEnabled = true;
 }
 
+void CGovernanceManager::ScheduleObjectDeletion(const CGovernanceObject& govobj)
+{
+    LOCK(cs);
+
+    if(!govobj.IsSetCachedDelete() && !govobj.IsSetExpired()) {
+        return;
+    }
+
+    wheelDeletions.Schedule(govobj.GetHash(), govobj.GetDeletionTime() + GOVERNANCE_DELETION_DELAY);
+}
+
 CGovernanceObject *CGovernanceManager::FindGovernanceObject(const uint256& nHash)
 {
     LOCK(cs);
@@ -581,8 +786,8 @@ std::vector<CGovernanceVote> CGovernanceManager::GetCurrentVotes(const uint256&
     // Compile a list of Masternode collateral outpoints for which to get votes
     std::vector<CTxIn> vecMNTxIn;
     if (mnCollateralOutpointFilter == CTxIn()) {
-        std::vector<CMasternode> mnlist = mnodeman.GetFullMasternodeVector();
-        for (std::vector<CMasternode>::iterator it = mnlist.begin(); it != mnlist.end(); ++it)
+        CMasternodeListSnapshot_sptr pSnapshot = mnodeman.GetListSnapshot();
+        for (std::vector<CMasternode>::const_iterator it = pSnapshot->vMasternodes.begin(); it != pSnapshot->vMasternodes.end(); ++it)
         {
             vecMNTxIn.push_back(it->vin);
         }
@@ -752,8 +957,12 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
 
     LogPrint("gobject", "CGovernanceManager::Sync -- syncing to peer=%d, nProp = %s\n", pfrom->id, nProp.ToString());
 
+    // take a snapshot of what to send, votes are read and checked without holding cs
+    std::vector<uint256> vecObjHashes;
+    CGovernanceObjectVoteFile fileVotes;
+
     {
-        LOCK2(cs_main, cs);
+        LOCK(cs);
 
         if(nProp == uint256()) {
             // all valid objects, no votes
@@ -769,10 +978,7 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
                     continue;
                 }
 
-                // Push the inventory budget proposal message over to the other client
-                LogPrint("gobject", "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", strHash, pfrom->id);
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
-                ++nObjCount;
+                vecObjHashes.push_back(it->first);
             }
         } else {
             // single valid object and its valid votes
@@ -792,28 +998,127 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
                 return;
             }
 
-            // Push the inventory budget proposal message over to the other client
-            LogPrint("gobject", "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", strHash, pfrom->id);
-            pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
-            ++nObjCount;
+            vecObjHashes.push_back(it->first);
+            fileVotes = govobj.GetVoteFile();
+        }
+    }
 
-            std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                if(!vecVotes[i].IsValid(true)) {
-                    continue;
-                }
-                if(filter.contains(vecVotes[i].GetHash())) {
+    for(size_t i = 0; i < vecObjHashes.size(); ++i) {
+        // Push the inventory budget proposal message over to the other client
+        LogPrint("gobject", "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", vecObjHashes[i].ToString(), pfrom->id);
+        pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, vecObjHashes[i]));
+        ++nObjCount;
+    }
+
+    std::vector<CGovernanceVote> vecVotes = fileVotes.GetVotes();
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        if(!vecVotes[i].IsValid(true)) {
+            continue;
+        }
+        if(filter.contains(vecVotes[i].GetHash())) {
+            continue;
+        }
+        pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
+        ++nVoteCount;
+    }
+
+    pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, nObjCount);
+    pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount);
+    LogPrintf("CGovernanceManager::Sync -- sent %d objects and %d votes to peer=%d\n", nObjCount, nVoteCount, pfrom->id);
+}
+
+void CGovernanceManager::SyncVoteDeltas(CNode* pfrom, const std::vector<CGovernanceObjectVoteSummary>& vecSummary)
+{
+    // do not provide any data until our node is synced
+    if(fMasterNode && !masternodeSync.IsSynced()) return;
+
+    // take a snapshot of the objects the peer may miss votes for, votes are read without holding cs
+    std::vector<std::pair<CGovernanceObjectVoteFile, CGovernanceObjectVoteSummary> > vecDeltas;
+
+    {
+        LOCK(cs);
+
+        for(size_t i = 0; i < vecSummary.size(); ++i) {
+            const CGovernanceObjectVoteSummary& summary = vecSummary[i];
+            object_m_it it = mapObjects.find(summary.nObjectHash);
+            if(it == mapObjects.end()) continue;
+            CGovernanceObject& govobj = it->second;
+            if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) continue;
+
+            const CGovernanceObjectVoteFile& fileVotes = govobj.GetVoteFile();
+            if(fileVotes.GetVoteCount() == 0) continue;
+            // the peer has the same votes as we do
+            if(fileVotes.GetVoteCount() == summary.nVoteCount && fileVotes.GetVoteSetHash() == summary.hashVoteSet) continue;
+
+            vecDeltas.push_back(std::make_pair(fileVotes, summary));
+        }
+    }
+
+    int nVoteCount = 0;
+    std::vector<CGovernanceVote> vecBatch;
+
+    for(size_t i = 0; i < vecDeltas.size(); ++i) {
+        const CGovernanceObjectVoteSummary& summary = vecDeltas[i].second;
+        std::vector<CGovernanceVote> vecVotes = vecDeltas[i].first.GetVotes();
+        std::vector<CGovernanceVote> vecMissing;
+
+        if(!GetMissingVotes(vecVotes, summary, vecMissing)) {
+            // We can't tell which votes the peer has, offer all of them as Sync does,
+            // the peer asks only for those it doesn't have yet
+            for(size_t j = 0; j < vecVotes.size(); ++j) {
+                if(!vecVotes[j].IsValid(false)) {
                     continue;
                 }
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
+                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[j].GetHash()));
                 ++nVoteCount;
             }
+            continue;
+        }
+
+        for(size_t j = 0; j < vecMissing.size(); ++j) {
+            // signatures were checked when the votes were accepted
+            if(!vecMissing[j].IsValid(false)) {
+                continue;
+            }
+            vecBatch.push_back(vecMissing[j]);
+            ++nVoteCount;
+            if(vecBatch.size() >= MAX_VOTE_BATCH_SIZE) {
+                pfrom->PushMessage(NetMsgType::MNGOVERNANCEVOTES, vecBatch);
+                vecBatch.clear();
+            }
         }
     }
 
-    pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, nObjCount);
+    if(!vecBatch.empty()) {
+        pfrom->PushMessage(NetMsgType::MNGOVERNANCEVOTES, vecBatch);
+    }
+
     pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount);
-    LogPrintf("CGovernanceManager::Sync -- sent %d objects and %d votes to peer=%d\n", nObjCount, nVoteCount, pfrom->id);
+    LogPrintf("CGovernanceManager::SyncVoteDeltas -- sent %d votes for %d of %d objects to peer=%d\n", nVoteCount, vecDeltas.size(), vecSummary.size(), pfrom->id);
+}
+
+bool CGovernanceManager::GetMissingVotes(const std::vector<CGovernanceVote>& vecVotes, const CGovernanceObjectVoteSummary& summary, std::vector<CGovernanceVote>& vecVotesRet)
+{
+    vecVotesRet.clear();
+
+    // None of the peer's votes is newer than its last one. If our votes up to that
+    // time are exactly the peer's votes, it misses all of our newer votes and no other.
+    std::set<uint256> setOlderHashes;
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        if(vecVotes[i].GetTimestamp() <= summary.nLastVoteTime) {
+            setOlderHashes.insert(vecVotes[i].GetHash());
+        }
+        else {
+            vecVotesRet.push_back(vecVotes[i]);
+        }
+    }
+
+    if(int(setOlderHashes.size()) != summary.nVoteCount ||
+       CGovernanceObjectVoteFile::GetVoteSetHash(setOlderHashes) != summary.hashVoteSet) {
+        vecVotesRet.clear();
+        return false;
+    }
+    return true;
 }
 
 bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, update_mode_enum_t eUpdateLast)
@@ -961,7 +1266,9 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
              << ", MN outpoint = " << vote.GetVinMasternode().prevout.ToStringShort()
              << ", governance object hash = " << vote.GetParentHash().ToString() << "\n";
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_WARNING);
-        if(mapOrphanVotes.Insert(nHashGovobj, vote_time_pair_t(vote, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME))) {
+        int64_t nExpirationTime = GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME;
+        if(mapOrphanVotes.Insert(nHashGovobj, vote_time_pair_t(vote, nExpirationTime))) {
+            wheelOrphanVotes.Schedule(std::make_pair(nHashGovobj, nHashVote), nExpirationTime);
             RequestGovernanceObject(pfrom, nHashGovobj);
             LogPrintf(ostr.str().c_str());
         }
@@ -981,11 +1288,15 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
     bool fOk = govobj.ProcessVote(pfrom, vote, exception);
     if(fOk) {
         mapVoteToObject.Insert(nHashVote, &govobj);
+        setDirtyObjects.insert(nHashGovobj);
 
         if(govobj.GetObjectType() == GOVERNANCE_OBJECT_WATCHDOG) {
             mnodeman.UpdateWatchdogVoteTime(vote.GetVinMasternode());
         }
     }
+    else if(govobj.HasOrphanVotes()) {
+        setObjectsWithOrphanVotes.insert(nHashGovobj);
+    }
     return fOk;
 }
 
@@ -993,8 +1304,24 @@ void CGovernanceManager::CheckMasternodeOrphanVotes()
 {
     LOCK2(cs_main, cs);
     fRateChecksEnabled = false;
-    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
-        it->second.CheckOrphanVotes();
+    hash_s_it it = setObjectsWithOrphanVotes.begin();
+    while(it != setObjectsWithOrphanVotes.end()) {
+        object_m_it itObj = mapObjects.find(*it);
+        if(itObj == mapObjects.end()) {
+            setObjectsWithOrphanVotes.erase(it++);
+            continue;
+        }
+        CGovernanceObject& govobj = itObj->second;
+        govobj.CheckOrphanVotes();
+        if(govobj.IsSetDirtyCache()) {
+            setDirtyObjects.insert(*it);
+        }
+        if(!govobj.HasOrphanVotes()) {
+            setObjectsWithOrphanVotes.erase(it++);
+        }
+        else {
+            ++it;
+        }
     }
     fRateChecksEnabled = true;
 }
@@ -1062,9 +1389,9 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
 
         if(pObj) {
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
-            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                filter.insert(vecVotes[i].GetHash());
+            const std::set<uint256>& setVoteHashes = pObj->GetVoteFile().GetVoteHashes();
+            for(std::set<uint256>::const_iterator it = setVoteHashes.begin(); it != setVoteHashes.end(); ++it) {
+                filter.insert(*it);
             }
         }
     }
@@ -1075,6 +1402,7 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
 int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode)
 {
     if(pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) return -3;
+    if(pnode->nVersion >= GOVERNANCE_SYNC_SUMMARY_PROTO_VERSION) return RequestGovernanceVoteDeltas(pnode);
     std::vector<CNode*> vNodesCopy;
     vNodesCopy.push_back(pnode);
     return RequestGovernanceObjectVotes(vNodesCopy);
@@ -1082,10 +1410,20 @@ int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode)
 
 int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy)
 {
-    static std::map<uint256, std::map<CService, int64_t> > mapAskedRecently;
-
     if(vNodesCopy.empty()) return -1;
 
+    // peers which support it get a summary of all objects instead,
+    // the objects summarized to them are marked in mapAskedRecently before we look at the rest
+    std::vector<CNode*> vNodesLegacy;
+    BOOST_FOREACH(CNode* pnode, vNodesCopy) {
+        if(pnode->nVersion >= GOVERNANCE_SYNC_SUMMARY_PROTO_VERSION) {
+            RequestGovernanceVoteDeltas(pnode);
+        } else {
+            vNodesLegacy.push_back(pnode);
+        }
+    }
+    if(vNodesLegacy.empty()) return 0;
+
     int64_t nNow = GetTime();
     int nTimeout = 60 * 60;
     size_t nPeersPerHashMax = 3;
@@ -1129,6 +1467,8 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
         }
     }
 
+    LOCK(cs);
+
     LogPrint("gobject", "CGovernanceManager::RequestGovernanceObjectVotes -- start: vpGovObjsTriggersTmp %d vpGovObjsTmp %d mapAskedRecently %d\n",
                 vpGovObjsTriggersTmp.size(), vpGovObjsTmp.size(), mapAskedRecently.size());
 
@@ -1148,7 +1488,7 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
             nHashGovobj = vpGovObjsTmp.back()->GetHash();
         }
         bool fAsked = false;
-        BOOST_FOREACH(CNode* pnode, vNodesCopy) {
+        BOOST_FOREACH(CNode* pnode, vNodesLegacy) {
             // Only use reqular peers, don't try to ask from outbound "masternode" connections -
             // they stay connected for a short period of time and it's possible that we won't get everything we should.
             // Only use outbound connections - inbound connection could be a "masternode" connection
@@ -1182,6 +1522,74 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
     return int(vpGovObjsTriggersTmp.size() + vpGovObjsTmp.size());
 }
 
+int CGovernanceManager::RequestGovernanceVoteDeltas(CNode* pnode)
+{
+    // same peers as in RequestGovernanceObjectVotes
+    if(pnode->fMasternode || (fMasterNode && pnode->fInbound)) return 0;
+
+    int64_t nNow = GetTime();
+    size_t nPeersPerHashMax = 3;
+    // objects summarized to the peer within SYNC_SUMMARY_PERIOD, they count against its limit
+    size_t nAskedFromPeer = 0;
+
+    std::vector<CGovernanceObjectVoteSummary> vecSummary;
+    int nObjsLeft = 0;
+
+    {
+        LOCK(cs);
+
+        if(mapObjects.empty()) return -2;
+
+        std::vector<object_m_it> vecToSummarize;
+        for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+            CGovernanceObject& govobj = it->second;
+            if(mapAskedRecently.count(it->first)) {
+                std::map<CService, int64_t>::iterator it1 = mapAskedRecently[it->first].begin();
+                while(it1 != mapAskedRecently[it->first].end()) {
+                    if(it1->second < nNow) {
+                        mapAskedRecently[it->first].erase(it1++);
+                    } else {
+                        ++it1;
+                    }
+                }
+                // already summarized to this peer, only objects it doesn't know about yet are sent
+                if(mapAskedRecently[it->first].count(pnode->addr)) {
+                    ++nAskedFromPeer;
+                    continue;
+                }
+                if(mapAskedRecently[it->first].size() >= nPeersPerHashMax) continue;
+            }
+            if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) continue;
+            vecToSummarize.push_back(it);
+        }
+
+        // the rest is left for the next request
+        size_t nSummaryMax = MAX_SYNC_SUMMARY_SIZE > nAskedFromPeer ? MAX_SYNC_SUMMARY_SIZE - nAskedFromPeer : 0;
+        if(vecToSummarize.size() > nSummaryMax) {
+            nObjsLeft = vecToSummarize.size() - nSummaryMax;
+            vecToSummarize.resize(nSummaryMax);
+        }
+
+        vecSummary.reserve(vecToSummarize.size());
+        for(size_t i = 0; i < vecToSummarize.size(); ++i) {
+            vecSummary.push_back(CGovernanceObjectVoteSummary(vecToSummarize[i]->first, vecToSummarize[i]->second.GetVoteFile()));
+        }
+
+        if(vecSummary.empty()) return nObjsLeft;
+
+        for(size_t i = 0; i < vecSummary.size(); ++i) {
+            mapAskedRecently[vecSummary[i].nObjectHash][pnode->addr] = nNow + SYNC_SUMMARY_PERIOD;
+        }
+    }
+
+    LogPrint("gobject", "CGovernanceManager::RequestGovernanceVoteDeltas -- asking for votes on %d objects, peer=%d\n", vecSummary.size(), pnode->id);
+
+    netfulfilledman.AddFulfilledRequest(pnode->addr, NetMsgType::MNGOVERNANCESYNCSUMMARY);
+    pnode->PushMessage(NetMsgType::MNGOVERNANCESYNCSUMMARY, vecSummary);
+
+    return nObjsLeft;
+}
+
 bool CGovernanceManager::AcceptObjectMessage(const uint256& nHash)
 {
     LOCK(cs);
@@ -1211,13 +1619,60 @@ void CGovernanceManager::RebuildIndexes()
     mapVoteToObject.Clear();
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         CGovernanceObject& govobj = it->second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-        for(size_t i = 0; i < vecVotes.size(); ++i) {
-            mapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+        const std::set<uint256>& setVoteHashes = govobj.GetVoteFile().GetVoteHashes();
+        for(std::set<uint256>::const_iterator it2 = setVoteHashes.begin(); it2 != setVoteHashes.end(); ++it2) {
+            mapVoteToObject.Insert(*it2, &govobj);
         }
     }
 }
 
+void CGovernanceManager::SyncVoteDB()
+{
+    std::set<uint256> setReferenced;
+    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+        const std::set<uint256>& setVoteHashes = it->second.GetVoteFile().GetVoteHashes();
+        setReferenced.insert(setVoteHashes.begin(), setVoteHashes.end());
+    }
+
+    // votes are written as they come in but the objects only at shutdown,
+    // drop the votes of a newer (or discarded) cache and forget votes we can't serve
+    std::set<uint256> setStored;
+    int nErased = 0;
+    if(!pgovernancevotedb->EraseVotesExcept(setReferenced, setStored, nErased)) {
+        LogPrintf("CGovernanceManager::SyncVoteDB -- failed to erase unreferenced votes\n");
+    }
+
+    int nMissing = 0;
+    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+        nMissing += it->second.GetVoteFile().RemoveMissingVotes(setStored);
+    }
+
+    LogPrintf("CGovernanceManager::SyncVoteDB -- %d votes, %d unreferenced votes erased, %d missing votes removed\n",
+              setStored.size(), nErased, nMissing);
+}
+
+void CGovernanceManager::RebuildTimers()
+{
+    setDirtyObjects.clear();
+    wheelWatchdogs.Clear();
+    wheelDeletions.Clear();
+    wheelOrphanVotes.Clear();
+
+    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+        setDirtyObjects.insert(it->first);
+        ScheduleObjectDeletion(it->second);
+    }
+
+    for(hash_time_m_it it = mapWatchdogObjects.begin(); it != mapWatchdogObjects.end(); ++it) {
+        wheelWatchdogs.Schedule(it->first, it->second);
+    }
+
+    const vote_mcache_t::list_t& listOrphanVotes = mapOrphanVotes.GetItemList();
+    for(vote_mcache_t::list_cit it = listOrphanVotes.begin(); it != listOrphanVotes.end(); ++it) {
+        wheelOrphanVotes.Schedule(std::make_pair(it->key, it->value.first.GetHash()), it->value.second);
+    }
+}
+
 int CGovernanceManager::GetMasternodeIndex(const CTxIn& masternodeVin)
 {
     LOCK(cs);
@@ -1261,7 +1716,9 @@ void CGovernanceManager::InitOnLoad()
     LOCK(cs);
     int64_t nStart = GetTimeMillis();
     LogPrintf("Preparing masternode indexes and governance triggers...\n");
+    SyncVoteDB();
     RebuildIndexes();
+    RebuildTimers();
     AddCachedTriggers();
     LogPrintf("Masternode indexes and governance triggers prepared  %dms\n", GetTimeMillis() - nStart);
     LogPrintf("     %s\n", ToString());
@@ -1356,17 +1813,25 @@ void CGovernanceManager::RequestOrphanObjects()
 void CGovernanceManager::CleanOrphanObjects()
 {
     LOCK(cs);
-    const vote_mcache_t::list_t& items = mapOrphanVotes.GetItemList();
 
     int64_t nNow = GetAdjustedTime();
 
-    vote_mcache_t::list_cit it = items.begin();
-    while(it != items.end()) {
-        vote_mcache_t::list_cit prevIt = it;
-        ++it;
-        const vote_time_pair_t& pairVote = prevIt->value;
-        if(pairVote.second < nNow) {
-            mapOrphanVotes.Erase(prevIt->key, prevIt->value);
+    std::vector<std::pair<uint256, uint256> > vecDue;
+    wheelOrphanVotes.Advance(nNow, vecDue);
+
+    // votes for the same object usually expire together, look at each object once
+    hash_s_t setParents;
+    for(size_t i = 0; i < vecDue.size(); ++i) {
+        setParents.insert(vecDue[i].first);
+    }
+
+    for(hash_s_it it = setParents.begin(); it != setParents.end(); ++it) {
+        std::vector<vote_time_pair_t> vecVotePairs;
+        mapOrphanVotes.GetAll(*it, vecVotePairs);
+        for(size_t i = 0; i < vecVotePairs.size(); ++i) {
+            if(vecVotePairs[i].second <= nNow) {
+                mapOrphanVotes.Erase(*it, vecVotePairs[i]);
+            }
         }
     }
 }
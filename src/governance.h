@@ -17,12 +17,14 @@
 #include "net.h"
 #include "sync.h"
 #include "timedata.h"
+#include "timerwheel.h"
 #include "util.h"
 
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
 class CGovernanceVote;
+class CMasternodeSignatureCheck;
 
 extern CGovernanceManager governance;
 
@@ -134,6 +136,49 @@ public:
     }
 };
 
+/**
+ * What a node knows about the votes for one governance object
+ *
+ * Sent in bulk (govsyncsum) to peers which support it, instead of asking for
+ * the votes of each object separately. The peer replies with batches of the
+ * votes we are missing (govvotes), or with the inventory of all its votes for
+ * objects where the summary doesn't tell which votes we have.
+ */
+class CGovernanceObjectVoteSummary
+{
+public:
+    uint256 nObjectHash;
+    int nVoteCount;
+    int64_t nLastVoteTime;
+    /// CGovernanceObjectVoteFile::GetVoteSetHash of the votes
+    uint256 hashVoteSet;
+
+    CGovernanceObjectVoteSummary()
+        : nObjectHash(),
+          nVoteCount(0),
+          nLastVoteTime(0),
+          hashVoteSet()
+    {}
+
+    CGovernanceObjectVoteSummary(const uint256& nObjectHashIn, const CGovernanceObjectVoteFile& fileVotes)
+        : nObjectHash(nObjectHashIn),
+          nVoteCount(fileVotes.GetVoteCount()),
+          nLastVoteTime(fileVotes.GetLastVoteTime()),
+          hashVoteSet(fileVotes.GetVoteSetHash())
+    {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nObjectHash);
+        READWRITE(nVoteCount);
+        READWRITE(nLastVoteTime);
+        READWRITE(hashVoteSet);
+    }
+};
+
 enum update_mode_enum_t {
     UPDATE_FALSE,
     UPDATE_TRUE,
@@ -224,6 +269,19 @@ public: // Types
 private:
     static const int MAX_CACHE_SIZE = 1000000;
 
+    /// Max number of objects in a single govsyncsum message, and in all govsyncsum
+    /// messages between a pair of peers within SYNC_SUMMARY_PERIOD
+    static const size_t MAX_SYNC_SUMMARY_SIZE = 10000;
+
+    /// Objects summarized to a peer are not summarized to it again for this long
+    static const int64_t SYNC_SUMMARY_PERIOD = 60 * 60;
+
+    /// Max number of votes in a single govvotes message
+    static const size_t MAX_VOTE_BATCH_SIZE = 500;
+
+    /// Received votes are verified in batches of this size
+    static const size_t VOTE_VERIFY_BATCH_SIZE = 256;
+
     static const std::string SERIALIZATION_VERSION_STRING;
 
     // Keep track of current block index
@@ -259,6 +317,42 @@ private:
 
     bool fRateChecksEnabled;
 
+    /// Objects whose cached variables UpdateCachesAndClean has to update
+    hash_s_t setDirtyObjects;
+
+    /// Objects holding votes from masternodes we don't know yet
+    hash_s_t setObjectsWithOrphanVotes;
+
+    /// Peers we asked for the votes of each object and until when we don't ask them again,
+    /// shared by the per-object and the summary vote sync
+    std::map<uint256, std::map<CService, int64_t> > mapAskedRecently;
+
+    /// Number of objects each peer summarized to us and when that count is reset
+    std::map<CNetAddr, std::pair<int64_t, size_t> > mapSummaryObjectsReceived;
+
+    /// Expiration times of watchdogs
+    TimerWheel<uint256> wheelWatchdogs;
+
+    /// Times objects flagged for deletion are erased at
+    TimerWheel<uint256> wheelDeletions;
+
+    /// Expiration times of orphan votes, by parent object and vote hash
+    TimerWheel<std::pair<uint256, uint256> > wheelOrphanVotes;
+
+    /// Held for a whole flush of the pending votes, so that flushes never interleave and
+    /// votes are processed in the order they arrived; taken before cs and cs_main
+    CCriticalSection cs_pendingvotes;
+
+    /// Votes received (with the referenced peers they came from) waiting for their signatures
+    /// to be verified in parallel, they are processed in the order they arrived
+    std::vector<std::pair<CNode*, CGovernanceVote> > vecPendingVotes;
+
+    /// Set by the message handler once a whole batch of votes is pending, the DarkSend pool
+    /// thread waits for it on cvVoteBatchReady and flushes the batch
+    CWaitableCriticalSection cs_votebatchready;
+    CConditionVariable cvVoteBatchReady;
+    bool fVoteBatchReady;
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -283,8 +377,23 @@ public:
 
     void Sync(CNode* node, const uint256& nProp, const CBloomFilter& filter);
 
+    /// Send the votes described by vecSummary as missing to the peer in batches
+    void SyncVoteDeltas(CNode* pfrom, const std::vector<CGovernanceObjectVoteSummary>& vecSummary);
+
+    /**
+     * Select from vecVotes the votes a peer with the given summary misses, returns false
+     * if the summary doesn't tell which of them the peer has
+     */
+    static bool GetMissingVotes(const std::vector<CGovernanceVote>& vecVotes, const CGovernanceObjectVoteSummary& summary, std::vector<CGovernanceVote>& vecVotesRet);
+
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
+    /// Verify the signatures of pending votes in parallel and process them
+    void ProcessPendingVotes();
+
+    /// Wait up to nTimeoutMillis for a whole batch of votes to be pending, returns false on timeout
+    bool WaitForPendingVoteBatch(int64_t nTimeoutMillis);
+
     void DoMaintenance();
 
     CGovernanceObject *FindGovernanceObject(const uint256& nHash);
@@ -302,6 +411,9 @@ public:
 
     void CheckAndRemove() {UpdateCachesAndClean();}
 
+    /// Schedule erasing an object flagged for deletion or expired, does nothing for other objects
+    void ScheduleObjectDeletion(const CGovernanceObject& govobj);
+
     void Clear()
     {
         LOCK(cs);
@@ -316,6 +428,13 @@ public:
         mapInvalidVotes.Clear();
         mapOrphanVotes.Clear();
         mapLastMasternodeObject.clear();
+        setDirtyObjects.clear();
+        setObjectsWithOrphanVotes.clear();
+        mapAskedRecently.clear();
+        mapSummaryObjectsReceived.clear();
+        wheelWatchdogs.Clear();
+        wheelDeletions.Clear();
+        wheelOrphanVotes.Clear();
     }
 
     std::string ToString() const;
@@ -397,6 +516,9 @@ public:
 private:
     void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, bool fUseFilter = false);
 
+    /// Ask a peer for the votes we miss on all objects not asked from it yet, returns the number of objects left
+    int RequestGovernanceVoteDeltas(CNode* pnode);
+
     void AddInvalidVote(const CGovernanceVote& vote)
     {
         mapInvalidVotes.Insert(vote.GetHash(), vote);
@@ -404,11 +526,20 @@ private:
 
     void AddOrphanVote(const CGovernanceVote& vote)
     {
-        mapOrphanVotes.Insert(vote.GetHash(), vote_time_pair_t(vote, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME));
+        int64_t nExpirationTime = GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME;
+        if(mapOrphanVotes.Insert(vote.GetHash(), vote_time_pair_t(vote, nExpirationTime))) {
+            wheelOrphanVotes.Schedule(std::make_pair(vote.GetHash(), vote.GetHash()), nExpirationTime);
+        }
     }
 
     bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception);
 
+    /// Process a vote received from pfrom and relay it if it's new, must not be called with cs held
+    void ProcessReceivedVote(CNode* pfrom, const CGovernanceVote& vote);
+
+    /// Add the signature check of a vote we don't have yet to vChecks
+    void PrepareSignatureCheck(const CGovernanceVote& vote, std::vector<CMasternodeSignatureCheck>& vChecks);
+
     /// Called to indicate a requested object has been received
     bool AcceptObjectMessage(const uint256& nHash);
 
@@ -421,6 +552,12 @@ private:
 
     void RebuildIndexes();
 
+    /// Make the vote database match the vote files of the loaded objects
+    void SyncVoteDB();
+
+    /// Schedule all pending expirations and deletions again, after loading from disk
+    void RebuildTimers();
+
     /// Returns MN index, handling the case of index rebuilds
     int GetMasternodeIndex(const CTxIn& masternodeVin);
 
@@ -9,6 +9,7 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "cachemap.h"
 #include "auxpow.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -22,6 +23,7 @@
 #include "net.h"
 #include "policy/policy.h"
 #include "pow.h"
+#include "pubkey.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "script/script.h"
@@ -51,6 +53,8 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/math/distributions/poisson.hpp>
 #include <boost/thread.hpp>
@@ -74,6 +78,7 @@ int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nMaxMappedBlockFiles = DEFAULT_MAPPED_BLOCK_FILES;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
@@ -157,9 +162,26 @@ namespace {
      */
     multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
 
+    /** Recently used address balances and balance changes not flushed yet, see GetAddressBalance. */
+    CCriticalSection cs_addressBalances;
+    CacheMap<std::pair<uint160, int>, CAddressBalanceValue> addressBalanceCache(ADDRESS_BALANCE_CACHE_SIZE);
+    std::map<std::pair<uint160, int>, CAddressBalanceValue> mapAddressBalanceDeltas;
+    /** Block the address balances (on disk plus mapAddressBalanceDeltas) are at, guarded by cs_main */
+    uint256 hashAddressBalances;
+
     CCriticalSection cs_LastBlockFile;
     std::vector<CBlockFileInfo> vinfoBlockFile;
     int nLastBlockFile = 0;
+
+    /** A read-only mapping of a finalized block file, see -blockmmap. */
+    struct CMappedBlockFile {
+        boost::shared_ptr<boost::interprocess::mapped_region> region;
+        uint64_t nLastUse;
+    };
+    /** Block files that are currently mapped, at most nMaxMappedBlockFiles. */
+    CCriticalSection cs_mappedBlockFiles;
+    std::map<int, CMappedBlockFile> mapMappedBlockFiles;
+    uint64_t nMappedBlockFilesUse = 0;
     /** Global flag to indicate we should check to see if there are
      *  block/undo files that should be deleted.  Set on startup
      *  or if we allocate more file space when we're in prune mode
@@ -1063,7 +1085,7 @@ std::string FormatStateMessage(const CValidationState &state)
 }
 
 bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-                              bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee,
+                              bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit, bool fRejectAbsurdFee,
                               std::vector<uint256>& vHashTxnToUncache, bool fDryRun)
 {
     AssertLockHeld(cs_main);
@@ -1253,7 +1275,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             }
         }
 
-        CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx), inChainInputValue, fSpendsCoinbase, nSigOps, lp);
+        CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height(), pool.HasNoInputsOf(tx), inChainInputValue, fSpendsCoinbase, nSigOps, lp);
         unsigned int nSize = entry.GetTxSize();
 
         // Check that the transaction doesn't have an excessive number of
@@ -1502,6 +1524,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry, setAncestors, !IsInitialBlockDownload());
+        pool.NotifyEntryAccepted(tx);
 
         // Add memory address index
         if (fAddressIndex) {
@@ -1526,11 +1549,12 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
     return true;
 }
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-                        bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee, bool fDryRun)
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+                                bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit,
+                                bool fRejectAbsurdFee, bool fDryRun)
 {
     std::vector<uint256> vHashTxToUncache;
-    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, fOverrideMempoolLimit, fRejectAbsurdFee, vHashTxToUncache, fDryRun);
+    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, fOverrideMempoolLimit, fRejectAbsurdFee, vHashTxToUncache, fDryRun);
     if (!res || fDryRun) {
         if(!res) LogPrint("mempool", "%s: %s %s\n", __func__, tx.GetHash().ToString(), state.GetRejectReason());
         BOOST_FOREACH(const uint256& hashTx, vHashTxToUncache)
@@ -1539,6 +1563,50 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return res;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+                        bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee, bool fDryRun)
+{
+    return AcceptToMemoryPoolWithTime(pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), fOverrideMempoolLimit, fRejectAbsurdFee, fDryRun);
+}
+
+void LoadMempoolSnapshot(const CTxMemPoolSnapshot& snapshot)
+{
+    int64_t nStart = GetTimeMillis();
+    int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    int64_t nNow = GetTime();
+    int nAccepted = 0, nFailed = 0, nExpired = 0;
+
+    // Deltas go in first so that prioritised transactions are accepted with
+    // their modified fee, exactly as they were before the restart
+    for (std::map<uint256, std::pair<double, CAmount> >::const_iterator it = snapshot.mapDeltas.begin(); it != snapshot.mapDeltas.end(); ++it)
+        mempool.PrioritiseTransaction(it->first, it->first.ToString(), it->second.first, it->second.second);
+
+    for (std::vector<std::pair<CTransaction, int64_t> >::const_iterator it = snapshot.vTxAndTime.begin(); it != snapshot.vTxAndTime.end(); ++it) {
+        const CTransaction& tx = it->first;
+        int64_t nTime = it->second;
+        if (nTime + nExpiryTimeout <= nNow) {
+            ++nExpired;
+            continue;
+        }
+
+        // Transactions are stored parents first, so a missing input means the
+        // parent was rejected or mined meanwhile and there is nothing to retry.
+        // The relay fee and free rate limits apply as to any other transaction.
+        CValidationState state;
+        LOCK(cs_main);
+        if (AcceptToMemoryPoolWithTime(mempool, state, tx, true, NULL, nTime))
+            ++nAccepted;
+        else
+            ++nFailed;
+
+        if (ShutdownRequested())
+            return;
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired  %dms\n",
+              nAccepted, nFailed, nExpired, GetTimeMillis() - nStart);
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
 {
     if (!fTimestampIndex)
@@ -1576,6 +1644,141 @@ bool GetAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool ScanAddressIndex(uint160 addressHash, int type, int start, int end,
+                      const CAddressIndexKey* pkeyAfter,
+                      const boost::function<bool (const CAddressIndexKey&, CAmount)>& visitor)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ScanAddressIndex(addressHash, type, start, end, pkeyAfter, visitor))
+        return error("unable to scan address index");
+
+    return true;
+}
+
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue& balance)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    std::pair<uint160, int> key(addressHash, type);
+    LOCK(cs_addressBalances);
+    if (addressBalanceCache.Get(key, balance))
+        return true;
+
+    if (!pblocktree->ReadAddressBalance(addressHash, type, balance))
+        return error("unable to get balance for address");
+
+    std::map<std::pair<uint160, int>, CAddressBalanceValue>::const_iterator it = mapAddressBalanceDeltas.find(key);
+    if (it != mapAddressBalanceDeltas.end())
+        balance.Add(it->second);
+
+    addressBalanceCache.Insert(key, balance);
+    return true;
+}
+
+/**
+ * Apply the address index entries of a connected block to the address
+ * balances, or take them back out again if fDisconnect is set.
+ *
+ * The changes are kept in memory until the next chainstate flush, and are
+ * only applied on top of the block the balances are at. Blocks reconnected
+ * after a crash or by VerifyDB are already included and skipped.
+ */
+static void UpdateAddressBalances(const std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, const CBlockIndex* pindex, bool fDisconnect)
+{
+    AssertLockHeld(cs_main);
+    const uint256& hashBase = fDisconnect ? pindex->GetBlockHash() : pindex->pprev->GetBlockHash();
+    if (hashBase != hashAddressBalances) {
+        LogPrint("addressindex", "%s: balances at %s, skipping block %s\n", __func__, hashAddressBalances.ToString(), pindex->GetBlockHash().ToString());
+        return;
+    }
+    hashAddressBalances = fDisconnect ? pindex->pprev->GetBlockHash() : pindex->GetBlockHash();
+
+    // The entries of one transaction are adjacent, so a transaction is
+    // counted once per address by remembering the last one seen.
+    std::map<std::pair<uint160, int>, std::pair<CAddressBalanceValue, uint256> > mapDeltas;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
+        std::pair<CAddressBalanceValue, uint256>& delta = mapDeltas[std::make_pair(it->first.hashBytes, (int)it->first.type)];
+        if (it->second > 0)
+            delta.first.received += it->second;
+        delta.first.balance += it->second;
+        if (it->first.txhash != delta.second) {
+            delta.first.nTxCount++;
+            delta.second = it->first.txhash;
+        }
+    }
+
+    LOCK(cs_addressBalances);
+    for (std::map<std::pair<uint160, int>, std::pair<CAddressBalanceValue, uint256> >::iterator it = mapDeltas.begin(); it != mapDeltas.end(); it++) {
+        CAddressBalanceValue& delta = it->second.first;
+        if (fDisconnect) {
+            delta.balance = -delta.balance;
+            delta.received = -delta.received;
+            delta.nTxCount = -delta.nTxCount;
+        }
+        mapAddressBalanceDeltas[it->first].Add(delta);
+        CAddressBalanceValue balance;
+        if (addressBalanceCache.Get(it->first, balance)) {
+            balance.Add(delta);
+            addressBalanceCache.Insert(it->first, balance);
+        }
+    }
+}
+
+/**
+ * Write the address balance changes since the last flush, together with
+ * the block the balances are at. Called right after the chainstate was
+ * flushed, so that both describe the same block.
+ */
+static bool FlushAddressBalances()
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs_addressBalances);
+    std::vector<std::pair<std::pair<uint160, int>, CAddressBalanceValue> > vBalances;
+    vBalances.reserve(mapAddressBalanceDeltas.size());
+    for (std::map<std::pair<uint160, int>, CAddressBalanceValue>::const_iterator it = mapAddressBalanceDeltas.begin(); it != mapAddressBalanceDeltas.end(); it++) {
+        CAddressBalanceValue balance;
+        if (!pblocktree->ReadAddressBalance(it->first.first, it->first.second, balance))
+            return false;
+        balance.Add(it->second);
+        vBalances.push_back(std::make_pair(it->first, balance));
+    }
+
+    if (!pblocktree->WriteAddressBalances(vBalances, hashAddressBalances))
+        return false;
+    mapAddressBalanceDeltas.clear();
+    return true;
+}
+
+bool LoadAddressBalances(const CChainParams& chainparams)
+{
+    LOCK(cs_main);
+    if (!fAddressIndex)
+        return true;
+
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    uint256 hashTip = pindexTip ? pindexTip->GetBlockHash() : chainparams.GetConsensus().hashGenesisBlock;
+    {
+        LOCK(cs_addressBalances);
+        addressBalanceCache.Clear();
+        mapAddressBalanceDeltas.clear();
+    }
+    hashAddressBalances = hashTip;
+
+    // Balances are flushed after the chainstate; if the node stopped in
+    // between, or they predate this check, build them again.
+    uint256 hashBalances;
+    if (pblocktree->ReadAddressBalanceBestBlock(hashBalances) && hashBalances == hashTip)
+        return true;
+
+    LogPrintf("%s: address balances are not at the chain tip, building them from the address index...\n", __func__);
+    if (!pblocktree->RebuildAddressBalanceIndex(pindexTip ? pindexTip->nHeight : 0, hashTip))
+        return error("%s: failed to build address balances", __func__);
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
@@ -1733,22 +1936,90 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
 /* Generic implementation of block reading that can handle
    both a block and its header.  */
 
+/**
+ * Return a read-only mapping of block file nFile, or NULL if the file must be
+ * read through OpenBlockFile. Only files that no longer receive new blocks are
+ * mapped, and at most nMaxMappedBlockFiles of them; the least recently used
+ * mapping is dropped first. Readers keep a dropped mapping alive until done.
+ */
+static boost::shared_ptr<boost::interprocess::mapped_region> GetMappedBlockFile(int nFile)
+{
+    boost::shared_ptr<boost::interprocess::mapped_region> region;
+    if (nMaxMappedBlockFiles <= 0)
+        return region;
+
+    unsigned int nSize;
+    {
+        LOCK(cs_LastBlockFile);
+        if (nFile < 0 || nFile >= nLastBlockFile)
+            return region;
+        nSize = vinfoBlockFile[nFile].nSize;
+    }
+    if (nSize == 0)
+        return region;
+
+    LOCK(cs_mappedBlockFiles);
+    std::map<int, CMappedBlockFile>::iterator it = mapMappedBlockFiles.find(nFile);
+    if (it != mapMappedBlockFiles.end()) {
+        it->second.nLastUse = ++nMappedBlockFilesUse;
+        return it->second.region;
+    }
+
+    try {
+        boost::interprocess::file_mapping mapping(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk").string().c_str(), boost::interprocess::read_only);
+        region.reset(new boost::interprocess::mapped_region(mapping, boost::interprocess::read_only, 0, nSize));
+    } catch (const boost::interprocess::interprocess_exception& e) {
+        LogPrintf("%s: unable to map block file %05u: %s\n", __func__, nFile, e.what());
+        return region;
+    }
+
+    if (mapMappedBlockFiles.size() >= (size_t)nMaxMappedBlockFiles) {
+        std::map<int, CMappedBlockFile>::iterator itOldest = mapMappedBlockFiles.begin();
+        for (it = mapMappedBlockFiles.begin(); it != mapMappedBlockFiles.end(); ++it)
+            if (it->second.nLastUse < itOldest->second.nLastUse)
+                itOldest = it;
+        mapMappedBlockFiles.erase(itOldest);
+    }
+    CMappedBlockFile& mapped = mapMappedBlockFiles[nFile];
+    mapped.region = region;
+    mapped.nLastUse = ++nMappedBlockFilesUse;
+    return region;
+}
+
+static void UnmapBlockFile(int nFile)
+{
+    LOCK(cs_mappedBlockFiles);
+    mapMappedBlockFiles.erase(nFile);
+}
+
 template<typename T>
 static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk : OpenBlockFile failed");
+    boost::shared_ptr<boost::interprocess::mapped_region> region = GetMappedBlockFile(pos.nFile);
+    if (region && pos.nPos < region->get_size()) {
+        // Deserialize straight from the mapped file
+        CMemoryReader reader(static_cast<const char*>(region->get_address()) + pos.nPos, region->get_size() - pos.nPos, SER_DISK, CLIENT_VERSION);
+        try {
+            reader >> block;
+        }
+        catch (std::exception &e) {
+            return error("%s : Deserialize error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk : OpenBlockFile failed");
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (std::exception &e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (std::exception &e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Check the header
@@ -2033,6 +2304,81 @@ bool CScriptCheck::operator()() {
     return true;
 }
 
+bool CScriptCheck::EvalDeferred(CSignatureBatch& batch) {
+    const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    return VerifyScript(scriptSig, scriptPubKey, nFlags, CollectingTransactionSignatureChecker(ptxTo, nIn, batch), &error);
+}
+
+static bool HasCheckMultiSig(const CScript& script)
+{
+    opcodetype opcode;
+    for (CScript::const_iterator pc = script.begin(); pc != script.end() && script.GetOp(pc, opcode);) {
+        if (opcode == OP_CHECKMULTISIG || opcode == OP_CHECKMULTISIGVERIFY)
+            return true;
+    }
+    return false;
+}
+
+bool CScriptCheck::CanDefer() const {
+    if (cacheStore)
+        return false;
+    const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    if (!scriptSig.IsPushOnly() || HasCheckMultiSig(scriptPubKey))
+        return false;
+    if ((nFlags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash()) {
+        // the redeem script is the last push of scriptSig
+        std::vector<unsigned char> vchRedeemScript;
+        opcodetype opcode;
+        for (CScript::const_iterator pc = scriptSig.begin(); pc != scriptSig.end() && scriptSig.GetOp(pc, opcode, vchRedeemScript);) {}
+        if (HasCheckMultiSig(CScript(vchRedeemScript.begin(), vchRedeemScript.end())))
+            return false;
+    }
+    return true;
+}
+
+bool RunCheckBatch(std::vector<CScriptCheck>& vChecks)
+{
+    // Batches too small to benefit take the plain path.
+    if (vChecks.size() <= 1) {
+        BOOST_FOREACH(CScriptCheck& check, vChecks)
+            if (!check())
+                return false;
+        return true;
+    }
+
+    // Checks which can't be deferred are run right away and add nothing to the batch.
+    CSignatureBatch batch;
+    std::vector<bool> vEvalOk(vChecks.size());
+    std::vector<size_t> vBatchEnd(vChecks.size());
+    for (size_t i = 0; i < vChecks.size(); i++) {
+        if (vChecks[i].CanDefer()) {
+            vEvalOk[i] = vChecks[i].EvalDeferred(batch);
+        } else {
+            if (!vChecks[i]())
+                return false;
+            vEvalOk[i] = true;
+        }
+        vBatchEnd[i] = batch.size();
+    }
+
+    std::vector<bool> vValid;
+    batch.Verify(vValid);
+
+    // A check whose script failed with optimistic signature results, or
+    // which relied on an invalid signature, is re-evaluated exactly so the
+    // result and script error match non-batched validation.
+    size_t nBatchBegin = 0;
+    for (size_t i = 0; i < vChecks.size(); i++) {
+        bool fOk = vEvalOk[i];
+        for (size_t j = nBatchBegin; j < vBatchEnd[i] && fOk; j++)
+            fOk = vValid[j];
+        nBatchBegin = vBatchEnd[i];
+        if (!fOk && !vChecks[i]())
+            return false;
+    }
+    return true;
+}
+
 int GetSpendHeight(const CCoinsViewCache& inputs)
 {
     LOCK(cs_main);
@@ -2387,10 +2733,13 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
         return true;
     }
 
+    mnodeman.BlockDisconnected(block, pindex);
+
     if (fAddressIndex) {
         if (!pblocktree->EraseAddressIndex(addressIndex)) {
             return AbortNode(state, "Failed to delete address index");
         }
+        UpdateAddressBalances(addressIndex, pindex, true);
         if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
@@ -2431,6 +2780,107 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+namespace {
+
+/** Result slot for one UTXO entry read ahead of ConnectBlock. */
+struct CPrefetchedCoins
+{
+    uint256 txid;
+    CCoins coins;
+    bool fFound;
+
+    CPrefetchedCoins() : fFound(false) {}
+    CPrefetchedCoins(const uint256& txidIn) : txid(txidIn), fFound(false) {}
+};
+
+/**
+ * Closure representing one lookup in the backing coins database.
+ * Note that this stores a pointer to the result slot, which is owned by the
+ * thread that queued it and must outlive the queue run.
+ */
+class CCoinsPrefetchCheck
+{
+private:
+    const CCoinsViewCache *pcache;
+    CPrefetchedCoins *pentry;
+
+public:
+    CCoinsPrefetchCheck() : pcache(NULL), pentry(NULL) {}
+    CCoinsPrefetchCheck(const CCoinsViewCache& cacheIn, CPrefetchedCoins& entryIn) : pcache(&cacheIn), pentry(&entryIn) {}
+
+    bool operator()() {
+        pentry->fFound = pcache->GetCoinsFromBase(pentry->txid, pentry->coins);
+        return true;
+    }
+
+    void swap(CCoinsPrefetchCheck &check) {
+        std::swap(pcache, check.pcache);
+        std::swap(pentry, check.pentry);
+    }
+};
+
+} // anon namespace
+
+static CCheckQueue<CCoinsPrefetchCheck> coinsprefetchqueue(16);
+
+void ThreadCoinsPrefetch() {
+    RenameThread("terracoin-prefetch");
+    coinsprefetchqueue.Thread();
+}
+
+/**
+ * Load every coin the block spends into pcoinsTip before it gets connected,
+ * so that ConnectBlock finds its inputs in memory and the script check
+ * threads are fed without waiting on the database one input at a time.
+ * The reads are spread over the prefetch threads; only the calling thread
+ * touches pcoinsTip itself.
+ */
+static void PrefetchBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+
+    if (!nScriptCheckThreads || block.vtx.size() <= 1)
+        return;
+
+    std::set<uint256> setSeen;
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        // Outputs created within the block itself are never in the database
+        setSeen.insert(tx.GetHash());
+    }
+
+    std::vector<CPrefetchedCoins> vEntries;
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+            if (!setSeen.insert(txin.prevout.hash).second)
+                continue;
+            if (pcoinsTip->HaveCoinsInCache(txin.prevout.hash))
+                continue;
+            vEntries.push_back(CPrefetchedCoins(txin.prevout.hash));
+        }
+    }
+    if (vEntries.empty())
+        return;
+
+    // vEntries is not resized from here on, so the checks can point into it
+    {
+        CCheckQueueControl<CCoinsPrefetchCheck> control(&coinsprefetchqueue);
+        std::vector<CCoinsPrefetchCheck> vChecks;
+        vChecks.reserve(vEntries.size());
+        BOOST_FOREACH(CPrefetchedCoins& entry, vEntries) {
+            vChecks.push_back(CCoinsPrefetchCheck(*pcoinsTip, entry));
+        }
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    BOOST_FOREACH(CPrefetchedCoins& entry, vEntries) {
+        if (entry.fFound)
+            pcoinsTip->AddFetchedCoins(entry.txid, entry.coins);
+    }
+}
+
 //
 // Called periodically asynchronously; alerts if it smells like
 // we're being fed a bad chain (blocks being generated much
@@ -2858,6 +3308,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             return AbortNode(state, "Failed to write address index");
         }
 
+        UpdateAddressBalances(addressIndex, pindex, false);
+
         if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
@@ -2871,6 +3323,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
             return AbortNode(state, "Failed to write timestamp index");
 
+    mnodeman.BlockConnected(block, pindex);
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2985,6 +3439,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         // Flush the chainstate (which may refer to block index entries).
         if (!pcoinsTip->Flush())
             return AbortNode(state, "Failed to write to coin database");
+        // Then the address balances, which are only valid together with the chainstate.
+        if (fAddressIndex && !FlushAddressBalances())
+            return AbortNode(state, "Failed to write address balances");
         nLastFlush = nNow;
     }
     if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000)) {
@@ -3117,6 +3574,7 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetchTotal = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -3141,6 +3599,10 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    PrefetchBlockInputs(*pblock);
+    int64_t nTimePrefetch = GetTimeMicros(); nTimePrefetchTotal += nTimePrefetch - nTime2;
+    LogPrint("bench", "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTimePrefetch - nTime2) * 0.001, nTimePrefetchTotal * 0.000001);
+    nTime2 = nTimePrefetch;
     {
         CCoinsViewCache view(pcoinsTip);
         bool rv = ConnectBlock(*pblock, state, pindexNew, view);
@@ -3745,7 +4207,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     // because we receive the wrong transactions for it.
 
     // Size limits
-    if (block.vtx.empty() || block.vtx.size() > MAX_BLOCK_SIZE || ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION) > MAX_BLOCK_SIZE)
+    if (block.vtx.empty() || block.vtx.size() > MAX_BLOCK_SIZE || block.GetSerializeSizeCached(SER_NETWORK, PROTOCOL_VERSION) > MAX_BLOCK_SIZE)
         return state.DoS(100, error("CheckBlock(): size limits failed"),
                          REJECT_INVALID, "bad-blk-length");
 
@@ -4011,7 +4473,7 @@ static bool AcceptBlock(const CBlock& block, CValidationState& state, const CCha
 
     // Write block to history file
     try {
-        unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        unsigned int nBlockSize = block.GetSerializeSizeCached(SER_DISK, CLIENT_VERSION);
         CDiskBlockPos blockPos;
         if (dbp != NULL)
             blockPos = *dbp;
@@ -4155,6 +4617,7 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
 {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        UnmapBlockFile(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -29,6 +29,7 @@
 #include <utility>
 #include <vector>
 
+#include <boost/function.hpp>
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
@@ -37,7 +38,9 @@ class CBloomFilter;
 class CChainParams;
 class CInv;
 class CScriptCheck;
+class CSignatureBatch;
 class CTxMemPool;
+class CTxMemPoolSnapshot;
 class CValidationInterface;
 class CValidationState;
 
@@ -67,6 +70,8 @@ static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Default for -persistmempool, dump the mempool on shutdown and reload it on startup */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -78,6 +83,8 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -blockmmap default (number of block files kept memory-mapped for reads, 0 = disabled) */
+static const int DEFAULT_MAPPED_BLOCK_FILES = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -117,6 +124,8 @@ static const unsigned int DEFAULT_BYTES_PER_SIGOP = 20;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_ADDRESSINDEX = false;
+/** Number of address balances kept in memory by GetAddressBalance */
+static const unsigned int ADDRESS_BALANCE_CACHE_SIZE = 50000;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
@@ -146,6 +155,7 @@ extern CConditionVariable cvBlockChange;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nMaxMappedBlockFiles;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
@@ -232,6 +242,8 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the coins prefetching thread */
+void ThreadCoinsPrefetch();
 
 /** Try to detect Partition (network isolation) attacks against us */
 void PartitionCheck(bool (*initialDownloadCheck)(), CCriticalSection& cs, const CBlockIndex *const &bestHeader, int64_t nPowTargetSpacing);
@@ -291,6 +303,14 @@ void PruneAndFlush();
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
                         bool* pfMissingInputs, bool fOverrideMempoolLimit=false, bool fRejectAbsurdFee=false, bool fDryRun=false);
 
+/** (try to) add transaction to memory pool with a specified acceptance time **/
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+                                bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit=false,
+                                bool fRejectAbsurdFee=false, bool fDryRun=false);
+
+/** Re-accept the transactions and fee deltas of a mempool snapshot, skipping expired entries */
+void LoadMempoolSnapshot(const CTxMemPoolSnapshot& snapshot);
+
 int GetUTXOHeight(const COutPoint& outpoint);
 int GetInputAge(const CTxIn &txin);
 int GetInputAgeIX(const uint256 &nTXHash, const CTxIn &txin);
@@ -448,6 +468,42 @@ struct CAddressUnspentValue {
     }
 };
 
+/** Running totals of all address index entries of one address */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    int64_t nTxCount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(nTxCount);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        nTxCount = 0;
+    }
+
+    bool IsNull() const {
+        return (nTxCount == 0 && balance == 0 && received == 0);
+    }
+
+    void Add(const CAddressBalanceValue& delta) {
+        balance += delta.balance;
+        received += delta.received;
+        nTxCount += delta.nTxCount;
+    }
+};
+
 struct CAddressIndexKey {
     unsigned int type;
     uint160 hashBytes;
@@ -509,6 +565,10 @@ struct CAddressIndexKey {
         spending = false;
     }
 
+    friend bool operator==(const CAddressIndexKey& a, const CAddressIndexKey& b) {
+        return a.type == b.type && a.hashBytes == b.hashBytes && a.blockHeight == b.blockHeight &&
+               a.txindex == b.txindex && a.txhash == b.txhash && a.index == b.index && a.spending == b.spending;
+    }
 };
 
 struct CAddressIndexIteratorKey {
@@ -700,6 +760,22 @@ public:
 
     bool operator()();
 
+    /**
+     * Evaluate the script, recording signatures into batch instead of
+     * verifying them. A successful result only holds if every signature
+     * added to the batch turns out to be valid.
+     */
+    bool EvalDeferred(CSignatureBatch& batch);
+
+    /**
+     * Whether EvalDeferred can be used. Checks that populate the signature
+     * cache can't, and neither can scripts with CHECKMULTISIG: that opcode
+     * tries signatures against keys until they match, so the optimistic
+     * results record pairs that don't belong together and the whole script
+     * would have to be evaluated again.
+     */
+    bool CanDefer() const;
+
     void swap(CScriptCheck &check) {
         scriptPubKey.swap(check.scriptPubKey);
         std::swap(ptxTo, check.ptxTo);
@@ -712,11 +788,21 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/** Run a batch of script checks, verifying their signatures together (used by CCheckQueue). */
+bool RunCheckBatch(std::vector<CScriptCheck>& vChecks);
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
+/** Stream the address index entries of one address, see CBlockTreeDB::ScanAddressIndex */
+bool ScanAddressIndex(uint160 addressHash, int type, int start, int end,
+                      const CAddressIndexKey* pkeyAfter,
+                      const boost::function<bool (const CAddressIndexKey&, CAmount)>& visitor);
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue& balance);
+/** Make the address balances match the chain tip, called once the block index is loaded */
+bool LoadAddressBalances(const CChainParams& chainparams);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
 
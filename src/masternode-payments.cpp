@@ -21,6 +21,10 @@ CCriticalSection cs_vecPayees;
 CCriticalSection cs_mapMasternodeBlocks;
 CCriticalSection cs_mapMasternodePaymentVotes;
 
+CMasternodePayeeTable mnpayeetable;
+
+const std::string CMasternodePayments::SERIALIZATION_VERSION_STRING = "CMasternodePayments-Version-2";
+
 /**
 * IsBlockValueValid
 *
@@ -204,11 +208,115 @@ std::string GetRequiredPaymentsString(int nBlockHeight)
     return mnpayments.GetRequiredPaymentsString(nBlockHeight);
 }
 
+int CMasternodePayeeTable::GetId(const CScript& payee)
+{
+    std::map<CScript, int>::iterator it = mapIds.find(payee);
+    if(it != mapIds.end()) {
+        return it->second;
+    }
+    int nId = vecScripts.size();
+    vecScripts.push_back(payee);
+    mapIds.insert(std::make_pair(payee, nId));
+    return nId;
+}
+
+int CMasternodePayeeTable::FindId(const CScript& payee) const
+{
+    std::map<CScript, int>::const_iterator it = mapIds.find(payee);
+    return it == mapIds.end() ? -1 : it->second;
+}
+
+void CMasternodePayeeTable::Clear()
+{
+    vecScripts.clear();
+    mapIds.clear();
+}
+
 void CMasternodePayments::Clear()
 {
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
     mapMasternodeBlocks.clear();
     mapMasternodePaymentVotes.clear();
+    LOCK(cs_vecPayees);
+    mnpayeetable.Clear();
+}
+
+void CMasternodePayments::GetPayeeVoteHashes(std::map<int, std::vector<std::vector<uint256> > >& mapPayeeVoteHashesRet) const
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_vecPayees);
+
+    mapPayeeVoteHashesRet.clear();
+    for(std::map<int, CMasternodeBlockPayees>::const_iterator it = mapMasternodeBlocks.begin(); it != mapMasternodeBlocks.end(); ++it) {
+        std::vector<std::vector<uint256> >& vecPayeeVoteHashes = mapPayeeVoteHashesRet[it->first];
+        BOOST_FOREACH(const CMasternodePayee& payee, it->second.vecPayees) {
+            vecPayeeVoteHashes.push_back(payee.GetVoteHashes());
+        }
+    }
+}
+
+void CMasternodePayments::RebuildBlockPayees(const std::map<int, std::vector<std::vector<uint256> > >& mapPayeeVoteHashes)
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+
+    mapMasternodeBlocks.clear();
+    {
+        LOCK(cs_vecPayees);
+        mnpayeetable.Clear();
+    }
+
+    // Add the votes in the order they were added before they were saved, so that
+    // the payees end up in the same order and GetBestPayee breaks ties the same way ...
+    std::set<uint256> setVotesAdded;
+    for(std::map<int, std::vector<std::vector<uint256> > >::const_iterator itHeight = mapPayeeVoteHashes.begin(); itHeight != mapPayeeVoteHashes.end(); ++itHeight) {
+        BOOST_FOREACH(const std::vector<uint256>& vecVoteHashes, itHeight->second) {
+            BOOST_FOREACH(const uint256& hash, vecVoteHashes) {
+                std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.find(hash);
+                if(it == mapMasternodePaymentVotes.end() || !it->second.IsVerified() || it->second.nBlockHeight != itHeight->first) continue;
+                if(!setVotesAdded.insert(hash).second) continue;
+                AddVoteToBlockPayees(it->second);
+            }
+        }
+    }
+
+    // ... and any vote not listed there after them
+    std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.begin();
+    for(; it != mapMasternodePaymentVotes.end(); ++it) {
+        if(!it->second.IsVerified() || setVotesAdded.count(it->first)) continue;
+        AddVoteToBlockPayees(it->second);
+    }
+}
+
+void CMasternodePayments::AddVoteToBlockPayees(const CMasternodePaymentVote& vote)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+
+    std::map<int, CMasternodeBlockPayees>::iterator itBlock = mapMasternodeBlocks.find(vote.nBlockHeight);
+    if(itBlock == mapMasternodeBlocks.end()) {
+        itBlock = mapMasternodeBlocks.insert(std::make_pair(vote.nBlockHeight, CMasternodeBlockPayees(vote.nBlockHeight))).first;
+    }
+    itBlock->second.AddPayee(vote);
+}
+
+void CMasternodePayments::CompactPayeeTable()
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    LOCK(cs_vecPayees);
+
+    int nPayees = 0;
+    for(std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin(); it != mapMasternodeBlocks.end(); ++it) {
+        nPayees += it->second.vecPayees.size();
+    }
+    // every payee is usually voted for at a few heights only, don't bother until most scripts are unused
+    if(mnpayeetable.GetSize() <= 2 * nPayees) return;
+
+    CMasternodePayeeTable tableNew;
+    for(std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin(); it != mapMasternodeBlocks.end(); ++it) {
+        BOOST_FOREACH(CMasternodePayee& payee, it->second.vecPayees) {
+            payee.SetPayeeId(tableNew.GetId(mnpayeetable.GetScript(payee.GetPayeeId())));
+        }
+    }
+    LogPrint("mnpayments", "CMasternodePayments::CompactPayeeTable -- %d payee scripts, %d in use\n", mnpayeetable.GetSize(), tableNew.GetSize());
+    std::swap(mnpayeetable, tableNew);
 }
 
 bool CMasternodePayments::CanVote(COutPoint outMasternode, int nBlockHeight)
@@ -410,26 +518,23 @@ bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
     return false;
 }
 
-// Is this masternode scheduled to get paid soon?
+// Which masternodes are scheduled to get paid soon?
 // -- Only look ahead up to 8 blocks to allow for propagation of the latest 2 blocks of votes
-bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
+void CMasternodePayments::GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet)
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if(!pCurrentBlockIndex) return false;
-
-    CScript mnpayee;
-    mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
+    setPayeesRet.clear();
+    if(!pCurrentBlockIndex) return;
 
     CScript payee;
     for(int64_t h = pCurrentBlockIndex->nHeight; h <= pCurrentBlockIndex->nHeight + 8; h++){
         if(h == nNotBlockHeight) continue;
-        if(mapMasternodeBlocks.count(h) && mapMasternodeBlocks[h].GetBestPayee(payee) && mnpayee == payee) {
-            return true;
+        std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(h);
+        if(it != mapMasternodeBlocks.end() && it->second.GetBestPayee(payee)) {
+            setPayeesRet.insert(payee);
         }
     }
-
-    return false;
 }
 
 bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
@@ -464,13 +569,14 @@ void CMasternodeBlockPayees::AddPayee(const CMasternodePaymentVote& vote)
 {
     LOCK(cs_vecPayees);
 
+    int nPayeeId = mnpayeetable.GetId(vote.payee);
     BOOST_FOREACH(CMasternodePayee& payee, vecPayees) {
-        if (payee.GetPayee() == vote.payee) {
+        if (payee.GetPayeeId() == nPayeeId) {
             payee.AddVoteHash(vote.GetHash());
             return;
         }
     }
-    CMasternodePayee payeeNew(vote.payee, vote.GetHash());
+    CMasternodePayee payeeNew(nPayeeId, vote.GetHash());
     vecPayees.push_back(payeeNew);
 }
 
@@ -484,12 +590,16 @@ bool CMasternodeBlockPayees::GetBestPayee(CScript& payeeRet)
     }
 
     int nVotes = -1;
+    int nPayeeId = -1;
     BOOST_FOREACH(CMasternodePayee& payee, vecPayees) {
         if (payee.GetVoteCount() > nVotes) {
-            payeeRet = payee.GetPayee();
+            nPayeeId = payee.GetPayeeId();
             nVotes = payee.GetVoteCount();
         }
     }
+    if (nVotes > -1) {
+        payeeRet = mnpayeetable.GetScript(nPayeeId);
+    }
 
     return (nVotes > -1);
 }
@@ -498,8 +608,9 @@ bool CMasternodeBlockPayees::HasPayeeWithVotes(CScript payeeIn, int nVotesReq)
 {
     LOCK(cs_vecPayees);
 
+    int nPayeeId = mnpayeetable.FindId(payeeIn);
     BOOST_FOREACH(CMasternodePayee& payee, vecPayees) {
-        if (payee.GetVoteCount() >= nVotesReq && payee.GetPayee() == payeeIn) {
+        if (nPayeeId != -1 && payee.GetVoteCount() >= nVotesReq && payee.GetPayeeId() == nPayeeId) {
             return true;
         }
     }
@@ -528,13 +639,19 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
     // if we don't have at least MNPAYMENTS_SIGNATURES_REQUIRED signatures on a payee, approve whichever is the longest chain
     if(nMaxSignatures < MNPAYMENTS_SIGNATURES_REQUIRED) return true;
 
+    // payees paid the right amount by this transaction
+    std::set<int> setPaidIds;
+    BOOST_FOREACH(const CTxOut& txout, txNew.vout) {
+        if (nMasternodePayment != txout.nValue) continue;
+        int nPayeeId = mnpayeetable.FindId(txout.scriptPubKey);
+        if (nPayeeId != -1) setPaidIds.insert(nPayeeId);
+    }
+
     BOOST_FOREACH(CMasternodePayee& payee, vecPayees) {
         if (payee.GetVoteCount() >= MNPAYMENTS_SIGNATURES_REQUIRED) {
-            BOOST_FOREACH(CTxOut txout, txNew.vout) {
-                if (payee.GetPayee() == txout.scriptPubKey && nMasternodePayment == txout.nValue) {
-                    LogPrint("mnpayments", "CMasternodeBlockPayees::IsTransactionValid -- Found required payment\n");
-                    return true;
-                }
+            if (setPaidIds.count(payee.GetPayeeId())) {
+                LogPrint("mnpayments", "CMasternodeBlockPayees::IsTransactionValid -- Found required payment\n");
+                return true;
             }
 
             CTxDestination address1;
@@ -607,16 +724,17 @@ void CMasternodePayments::CheckAndRemove()
 
     std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.begin();
     while(it != mapMasternodePaymentVotes.end()) {
-        CMasternodePaymentVote vote = (*it).second;
+        int nBlockHeight = it->second.nBlockHeight;
 
-        if(pCurrentBlockIndex->nHeight - vote.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CMasternodePayments::CheckAndRemove -- Removing old Masternode payment: nBlockHeight=%d\n", vote.nBlockHeight);
+        if(pCurrentBlockIndex->nHeight - nBlockHeight > nLimit) {
+            LogPrint("mnpayments", "CMasternodePayments::CheckAndRemove -- Removing old Masternode payment: nBlockHeight=%d\n", nBlockHeight);
             mapMasternodePaymentVotes.erase(it++);
-            mapMasternodeBlocks.erase(vote.nBlockHeight);
+            mapMasternodeBlocks.erase(nBlockHeight);
         } else {
             ++it;
         }
     }
+    CompactPayeeTable();
     LogPrintf("CMasternodePayments::CheckAndRemove -- %s\n", ToString());
 }
 
@@ -796,8 +914,8 @@ void CMasternodePayments::Sync(CNode* pnode)
     for(int h = pCurrentBlockIndex->nHeight; h < pCurrentBlockIndex->nHeight + 20; h++) {
         if(mapMasternodeBlocks.count(h)) {
             BOOST_FOREACH(CMasternodePayee& payee, mapMasternodeBlocks[h].vecPayees) {
-                std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
-                BOOST_FOREACH(uint256& hash, vecVoteHashes) {
+                const std::vector<uint256>& vecVoteHashes = payee.GetVoteHashes();
+                BOOST_FOREACH(const uint256& hash, vecVoteHashes) {
                     if(!HasVerifiedPaymentVote(hash)) continue;
                     pnode->PushInventory(CInv(MSG_MASTERNODE_PAYMENT_VOTE, hash));
                     nInvCount++;
@@ -35,41 +35,59 @@ bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, CAmount bloc
 void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutMasternodeRet, std::vector<CTxOut>& voutSuperblockRet);
 std::string GetRequiredPaymentsString(int nBlockHeight);
 
+/**
+ * Interns payee scripts into small integer ids, so that votes for the same payee
+ * at different heights share one copy of its script and can be compared cheaply.
+ * Access is guarded by cs_vecPayees.
+ */
+class CMasternodePayeeTable
+{
+private:
+    std::vector<CScript> vecScripts;
+    std::map<CScript, int> mapIds;
+
+public:
+    /// Return the id of a payee script, adding it if it's not known yet
+    int GetId(const CScript& payee);
+    /// Return the id of a payee script or -1 if it's not known
+    int FindId(const CScript& payee) const;
+    const CScript& GetScript(int nId) const { return vecScripts[nId]; }
+
+    int GetSize() const { return vecScripts.size(); }
+    void Clear();
+};
+
+extern CMasternodePayeeTable mnpayeetable;
+
 class CMasternodePayee
 {
 private:
-    CScript scriptPubKey;
+    int nPayeeId;
     std::vector<uint256> vecVoteHashes;
 
 public:
     CMasternodePayee() :
-        scriptPubKey(),
+        nPayeeId(-1),
         vecVoteHashes()
         {}
 
-    CMasternodePayee(CScript payee, uint256 hashIn) :
-        scriptPubKey(payee),
+    CMasternodePayee(int nPayeeIdIn, uint256 hashIn) :
+        nPayeeId(nPayeeIdIn),
         vecVoteHashes()
     {
         vecVoteHashes.push_back(hashIn);
     }
 
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        READWRITE(*(CScriptBase*)(&scriptPubKey));
-        READWRITE(vecVoteHashes);
-    }
-
-    CScript GetPayee() { return scriptPubKey; }
+    int GetPayeeId() const { return nPayeeId; }
+    void SetPayeeId(int nPayeeIdIn) { nPayeeId = nPayeeIdIn; }
+    CScript GetPayee() const { return mnpayeetable.GetScript(nPayeeId); }
 
     void AddVoteHash(uint256 hashIn) { vecVoteHashes.push_back(hashIn); }
-    std::vector<uint256> GetVoteHashes() { return vecVoteHashes; }
-    int GetVoteCount() { return vecVoteHashes.size(); }
+    const std::vector<uint256>& GetVoteHashes() const { return vecVoteHashes; }
+    int GetVoteCount() const { return vecVoteHashes.size(); }
 };
 
-// Keep track of votes for payees from masternodes
+// Keep track of votes for payees from masternodes, rebuilt from the votes when loaded from disk
 class CMasternodeBlockPayees
 {
 public:
@@ -85,14 +103,6 @@ public:
         vecPayees()
         {}
 
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        READWRITE(nBlockHeight);
-        READWRITE(vecPayees);
-    }
-
     void AddPayee(const CMasternodePaymentVote& vote);
     bool GetBestPayee(CScript& payeeRet);
     bool HasPayeeWithVotes(CScript payeeIn, int nVotesReq);
@@ -150,7 +160,7 @@ public:
     bool IsValid(CNode* pnode, int nValidationHeight, std::string& strError);
     void Relay();
 
-    bool IsVerified() { return !vchSig.empty(); }
+    bool IsVerified() const { return !vchSig.empty(); }
     void MarkAsNotVerified() { vchSig.clear(); }
 
     std::string ToString() const;
@@ -172,6 +182,16 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
+    static const std::string SERIALIZATION_VERSION_STRING;
+
+    /// Vote hashes of the payees of every block, in the order the payees and votes were added
+    void GetPayeeVoteHashes(std::map<int, std::vector<std::vector<uint256> > >& mapPayeeVoteHashesRet) const;
+    /// Rebuild mapMasternodeBlocks from the verified votes, in the order given by mapPayeeVoteHashes first
+    void RebuildBlockPayees(const std::map<int, std::vector<std::vector<uint256> > >& mapPayeeVoteHashes);
+    void AddVoteToBlockPayees(const CMasternodePaymentVote& vote);
+    /// Drop payee scripts no vote refers to anymore from mnpayeetable
+    void CompactPayeeTable();
+
 public:
     std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -183,8 +203,32 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        std::string strVersion;
+        if(ser_action.ForRead()) {
+            READWRITE(strVersion);
+        }
+        else {
+            strVersion = SERIALIZATION_VERSION_STRING;
+            READWRITE(strVersion);
+        }
+
+        // don't try to parse files of another format, start over
+        if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
+            Clear();
+            return;
+        }
+
+        // payment blocks are not stored, they are rebuilt from the votes in the order
+        // their payees were added in, which decides ties in GetBestPayee
         READWRITE(mapMasternodePaymentVotes);
-        READWRITE(mapMasternodeBlocks);
+        std::map<int, std::vector<std::vector<uint256> > > mapPayeeVoteHashes;
+        if(!ser_action.ForRead()) {
+            GetPayeeVoteHashes(mapPayeeVoteHashes);
+        }
+        READWRITE(mapPayeeVoteHashes);
+        if(ser_action.ForRead()) {
+            RebuildBlockPayees(mapPayeeVoteHashes);
+        }
     }
 
     void Clear();
@@ -199,7 +243,7 @@ public:
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
-    bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
+    void GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet);
 
     bool CanVote(COutPoint outMasternode, int nBlockHeight);
 
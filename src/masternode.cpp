@@ -16,6 +16,43 @@
 #include <boost/lexical_cast.hpp>
 
 
+namespace {
+    /** Signatures verified by CMasternodeSignatureCheck, each of them is used once */
+    CCriticalSection cs_setVerifiedSignatures;
+    std::set<uint256> setVerifiedSignatures;
+    /** Batches are processed right after verification, this only bounds signatures never looked at */
+    const size_t MAX_VERIFIED_SIGNATURES = 10000;
+
+    uint256 GetSignatureHash(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const std::string& strMessage)
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << pubKey << vchSig << strMessage;
+        return ss.GetHash();
+    }
+}
+
+bool CMasternodeSignatureCheck::Verify(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet)
+{
+    {
+        LOCK(cs_setVerifiedSignatures);
+        if(setVerifiedSignatures.erase(GetSignatureHash(pubKey, vchSig, strMessage))) return true;
+    }
+    return darkSendSigner.VerifyMessage(pubKey, vchSig, strMessage, strErrorRet);
+}
+
+bool CMasternodeSignatureCheck::operator()()
+{
+    std::string strError;
+    if(!darkSendSigner.VerifyMessage(pubKey, vchSig, strMessage, strError)) return true;
+
+    LOCK(cs_setVerifiedSignatures);
+    if(setVerifiedSignatures.size() >= MAX_VERIFIED_SIGNATURES) {
+        setVerifiedSignatures.clear();
+    }
+    setVerifiedSignatures.insert(GetSignatureHash(pubKey, vchSig, strMessage));
+    return true;
+}
+
 CMasternode::CMasternode() :
     vin(),
     addr(),
@@ -95,7 +132,7 @@ CMasternode::CMasternode(const CMasternodeBroadcast& mnb) :
     nTimeLastPaid(0),
     nTimeLastWatchdogVote(mnb.sigTime),
     nActiveState(mnb.nActiveState),
-    nCacheCollateralBlock(0),
+    nCacheCollateralBlock(mnb.nCacheCollateralBlock),
     nBlockLastPaid(0),
     nProtocolVersion(mnb.nProtocolVersion),
     nPoSeBanScore(0),
@@ -111,7 +148,11 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb)
 {
     if(mnb.sigTime <= sigTime && !mnb.fRecovery) return false;
 
+    bool fPubKeyChanged = pubKeyMasternode != mnb.pubKeyMasternode;
     pubKeyMasternode = mnb.pubKeyMasternode;
+    if(fPubKeyChanged) {
+        mnodeman.MasternodePubKeyChanged();
+    }
     sigTime = mnb.sigTime;
     vchSig = mnb.vchSig;
     nProtocolVersion = mnb.nProtocolVersion;
@@ -137,6 +178,7 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb)
             return false;
         }
     }
+    mnodeman.MasternodeListEntryChanged(vin.prevout);
     return true;
 }
 
@@ -145,20 +187,28 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb)
 // the proof of work for that block. The further away they are the better, the furthest will win the election
 // and get paid this block
 //
-arith_uint256 CMasternode::CalculateScore(const uint256& blockHash)
+arith_uint256 CMasternode::GetBlockHashScore(const uint256& blockHash)
 {
-    uint256 aux = ArithToUint256(UintToArith256(vin.prevout.hash) + vin.prevout.n);
-
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     ss << blockHash;
-    arith_uint256 hash2 = UintToArith256(ss.GetHash());
+    return UintToArith256(ss.GetHash());
+}
+
+arith_uint256 CMasternode::CalculateScore(const uint256& blockHash)
+{
+    return CalculateScore(blockHash, GetBlockHashScore(blockHash));
+}
+
+arith_uint256 CMasternode::CalculateScore(const uint256& blockHash, const arith_uint256& hashBlockHash)
+{
+    uint256 aux = ArithToUint256(UintToArith256(vin.prevout.hash) + vin.prevout.n);
 
     CHashWriter ss2(SER_GETHASH, PROTOCOL_VERSION);
     ss2 << blockHash;
     ss2 << aux;
     arith_uint256 hash3 = UintToArith256(ss2.GetHash());
 
-    return (hash3 > hash2 ? hash3 - hash2 : hash2 - hash3);
+    return (hash3 > hashBlockHash ? hash3 - hashBlockHash : hashBlockHash - hash3);
 }
 
 void CMasternode::Check(bool fForce)
@@ -342,62 +392,20 @@ std::string CMasternode::GetStatus() const
 
 int CMasternode::GetCollateralAge()
 {
-    int nHeight;
-    {
-        TRY_LOCK(cs_main, lockMain);
-        if(!lockMain || !chainActive.Tip()) return -1;
-        nHeight = chainActive.Height();
-    }
-
-    if (nCacheCollateralBlock == 0) {
-        int nInputAge = GetInputAge(vin);
-        if(nInputAge > 0) {
-            nCacheCollateralBlock = nHeight - nInputAge;
-        } else {
-            return nInputAge;
-        }
-    }
+    // nCacheCollateralBlock is set when the broadcast is checked and kept up to date by mnodeman
+    int nHeight = mnodeman.GetCachedBlockHeight();
+    if(nCacheCollateralBlock == 0 || nHeight == 0) return -1;
 
-    return nHeight - nCacheCollateralBlock;
+    return nHeight - nCacheCollateralBlock + 1;
 }
 
-void CMasternode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanBack)
+void CMasternode::UpdateLastPaid(int nBlockLastPaidIn, int64_t nTimeLastPaidIn)
 {
-    if(!pindex) return;
-
-    const CBlockIndex *BlockReading = pindex;
-
-    CScript mnpayee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
-    // LogPrint("masternode", "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s\n", vin.prevout.ToStringShort());
-
-    LOCK(cs_mapMasternodeBlocks);
-
-    for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
-        if(mnpayments.mapMasternodeBlocks.count(BlockReading->nHeight) &&
-            mnpayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2))
-        {
-            CBlock block;
-            if(!ReadBlockFromDisk(block, BlockReading)) // shouldn't really happen
-                continue;
-
-            CAmount nMasternodePayment = GetMasternodePayment(BlockReading->nHeight, block.vtx[0].GetValueOut());
-
-            BOOST_FOREACH(CTxOut txout, block.vtx[0].vout)
-                if(mnpayee == txout.scriptPubKey && nMasternodePayment == txout.nValue) {
-                    nBlockLastPaid = BlockReading->nHeight;
-                    nTimeLastPaid = BlockReading->nTime;
-                    LogPrint("masternode", "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
-                    return;
-                }
-        }
-
-        if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
-        BlockReading = BlockReading->pprev;
+    if(nBlockLastPaid != nBlockLastPaidIn) {
+        LogPrint("masternode", "CMasternode::UpdateLastPaid -- masternode=%s, last paid block %d -> %d\n", vin.prevout.ToStringShort(), nBlockLastPaid, nBlockLastPaidIn);
     }
-
-    // Last payment for this masternode wasn't found in latest mnpayments blocks
-    // or it was found in mnpayments blocks but wasn't found in the blockchain.
-    // LogPrint("masternode", "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s -- keeping old %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
+    nBlockLastPaid = nBlockLastPaidIn;
+    nTimeLastPaid = nTimeLastPaidIn;
 }
 
 bool CMasternodeBroadcast::Create(std::string strService, std::string strKeyMasternode, std::string strTxHash, std::string strOutputIndex, std::string& strErrorRet, CMasternodeBroadcast &mnbRet, bool fOffline)
@@ -635,6 +643,7 @@ bool CMasternodeBroadcast::CheckOutpoint(int& nDos)
             mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
             return false;
         }
+        nCacheCollateralBlock = coins.nHeight;
     }
 
     LogPrint("masternode", "CMasternodeBroadcast::CheckOutpoint -- Masternode UTXO verified\n");
@@ -693,19 +702,22 @@ bool CMasternodeBroadcast::Sign(CKey& keyCollateralAddress)
     return true;
 }
 
+std::string CMasternodeBroadcast::GetSignatureMessage() const
+{
+    return addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
+                    pubKeyCollateralAddress.GetID().ToString() + pubKeyMasternode.GetID().ToString() +
+                    boost::lexical_cast<std::string>(nProtocolVersion);
+}
+
 bool CMasternodeBroadcast::CheckSignature(int& nDos)
 {
-    std::string strMessage;
+    std::string strMessage = GetSignatureMessage();
     std::string strError = "";
     nDos = 0;
 
-    strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
-                    pubKeyCollateralAddress.GetID().ToString() + pubKeyMasternode.GetID().ToString() +
-                    boost::lexical_cast<std::string>(nProtocolVersion);
-
     LogPrint("masternode", "CMasternodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
 
-    if(!darkSendSigner.VerifyMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)){
+    if(!CMasternodeSignatureCheck::Verify(pubKeyCollateralAddress, vchSig, strMessage, strError)){
         LogPrintf("CMasternodeBroadcast::CheckSignature -- Got bad Masternode announce signature, error: %s\n", strError);
         nDos = 100;
         return false;
@@ -752,13 +764,18 @@ bool CMasternodePing::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     return true;
 }
 
+std::string CMasternodePing::GetSignatureMessage() const
+{
+    return vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+}
+
 bool CMasternodePing::CheckSignature(CPubKey& pubKeyMasternode, int &nDos)
 {
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetSignatureMessage();
     std::string strError = "";
     nDos = 0;
 
-    if(!darkSendSigner.VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
+    if(!CMasternodeSignatureCheck::Verify(pubKeyMasternode, vchSig, strMessage, strError)) {
         LogPrintf("CMasternodePing::CheckSignature -- Got bad Masternode ping signature, masternode=%s, error: %s\n", vin.prevout.ToStringShort(), strError);
         nDos = 33;
         return false;
@@ -853,6 +870,7 @@ bool CMasternodePing::CheckAndUpdate(CMasternode* pmn, bool fFromNewBroadcast, i
     // let's store this ping as the last one
     LogPrint("masternode", "CMasternodePing::CheckAndUpdate -- Masternode ping accepted, masternode=%s\n", vin.prevout.ToStringShort());
     pmn->lastPing = *this;
+    mnodeman.MasternodeListEntryChanged(vin.prevout);
 
     // and update mnodeman.mapSeenMasternodeBroadcast.lastPing which is probably outdated
     CMasternodeBroadcast mnb(*pmn);
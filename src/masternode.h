@@ -26,6 +26,37 @@ static const int MASTERNODE_NEW_START_REQUIRED_SECONDS  = 180 * 60;
 static const int MASTERNODE_POSE_BAN_MAX_SCORE          = 5;
 
 static const CAmount MASTERNODE_COLLATERAL = 5000 * COIN;
+/**
+ * Verifies the signature of a masternode broadcast, ping or governance vote ahead
+ * of processing it, so that a batch of them can be verified on the signature check
+ * threads. Valid signatures are remembered and not verified again by Verify().
+ */
+class CMasternodeSignatureCheck
+{
+private:
+    CPubKey pubKey;
+    std::vector<unsigned char> vchSig;
+    std::string strMessage;
+
+public:
+    CMasternodeSignatureCheck() {}
+    CMasternodeSignatureCheck(const CPubKey& pubKeyIn, const std::vector<unsigned char>& vchSigIn, const std::string& strMessageIn) :
+        pubKey(pubKeyIn), vchSig(vchSigIn), strMessage(strMessageIn) {}
+
+    /// Always succeeds, invalid signatures are simply not remembered and fail later in Verify
+    bool operator()();
+
+    /// Verify a signature, skipping the verification if it was checked in a batch before
+    static bool Verify(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
+
+    void swap(CMasternodeSignatureCheck& check)
+    {
+        std::swap(pubKey, check.pubKey);
+        vchSig.swap(check.vchSig);
+        strMessage.swap(check.strMessage);
+    }
+};
+
 //
 // The Masternode Ping Class : Contains a different serialize method for sending pings from masternodes throughout the network
 //
@@ -82,6 +113,7 @@ public:
     bool IsExpired() { return GetTime() - sigTime > MASTERNODE_NEW_START_REQUIRED_SECONDS; }
 
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
+    std::string GetSignatureMessage() const;
     bool CheckSignature(CPubKey& pubKeyMasternode, int &nDos);
     bool SimpleCheck(int& nDos);
     bool CheckAndUpdate(CMasternode* pmn, bool fFromNewBroadcast, int& nDos);
@@ -170,7 +202,7 @@ public:
     int64_t nTimeLastPaid;
     int64_t nTimeLastWatchdogVote;
     int nActiveState;
-    int nCacheCollateralBlock;
+    int nCacheCollateralBlock; // height of the block the collateral was confirmed in
     int nBlockLastPaid;
     int nProtocolVersion;
     int nPoSeBanScore;
@@ -244,6 +276,10 @@ public:
 
     // CALCULATE A RANK AGAINST OF GIVEN BLOCK
     arith_uint256 CalculateScore(const uint256& blockHash);
+    /// Same as above, with GetBlockHashScore(blockHash) computed once by the caller
+    arith_uint256 CalculateScore(const uint256& blockHash, const arith_uint256& hashBlockHash);
+    /// The part of the score that only depends on the block
+    static arith_uint256 GetBlockHashScore(const uint256& blockHash);
 
     bool UpdateFromNewBroadcast(CMasternodeBroadcast& mnb);
 
@@ -307,9 +343,9 @@ public:
 
     int GetCollateralAge();
 
-    int GetLastPaidTime() { return nTimeLastPaid; }
-    int GetLastPaidBlock() { return nBlockLastPaid; }
-    void UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanBack);
+    int GetLastPaidTime() const { return nTimeLastPaid; }
+    int GetLastPaidBlock() const { return nBlockLastPaid; }
+    void UpdateLastPaid(int nBlockLastPaidIn, int64_t nTimeLastPaidIn);
 
     // KEEP TRACK OF EACH GOVERNANCE ITEM INCASE THIS NODE GOES OFFLINE, SO WE CAN RECALC THEIR STATUS
     void AddGovernanceVote(uint256 nGovernanceObjectHash);
@@ -384,6 +420,7 @@ public:
     bool CheckOutpoint(int& nDos);
 
     bool Sign(CKey& keyCollateralAddress);
+    std::string GetSignatureMessage() const;
     bool CheckSignature(int& nDos);
     void Relay();
 };
@@ -4,27 +4,38 @@
 
 #include "activemasternode.h"
 #include "addrman.h"
+#include "checkqueue.h"
 #include "darksend.h"
 #include "governance.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "netfulfilledman.h"
+#include "scheduler.h"
+#include "script/standard.h"
 #include "util.h"
 
 /** Masternode manager */
 CMasternodeMan mnodeman;
 
-const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-4";
+static CCheckQueue<CMasternodeSignatureCheck> mnsigcheckqueue(128);
+/** The queue serves one batch at a time, masternode broadcasts and governance votes take turns */
+static CCriticalSection cs_mnsigcheckqueue;
 
-struct CompareLastPaidBlock
+void ThreadMasternodeSignatureCheck() {
+    RenameThread("terracoin-mnsigcheck");
+    mnsigcheckqueue.Thread();
+}
+
+void VerifyMasternodeSignatures(std::vector<CMasternodeSignatureCheck>& vChecks)
 {
-    bool operator()(const std::pair<int, CMasternode*>& t1,
-                    const std::pair<int, CMasternode*>& t2) const
-    {
-        return (t1.first != t2.first) ? (t1.first < t2.first) : (t1.second->vin < t2.second->vin);
-    }
-};
+    LOCK(cs_mnsigcheckqueue);
+    CCheckQueueControl<CMasternodeSignatureCheck> control(&mnsigcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-8";
 
 struct CompareScoreMN
 {
@@ -98,11 +109,29 @@ void CMasternodeIndex::RebuildIndex()
 
 CMasternodeMan::CMasternodeMan()
 : cs(),
+  nCachedBlockHeight(0),
   vMasternodes(),
+  mapMasternodeByOutpoint(),
+  mapMasternodeByPubKey(),
+  mapMasternodeByPayee(),
+  setPaymentQueue(),
+  mapRankingCache(),
+  listRankingCacheOrder(),
+  mapPayeeLastPaid(),
+  hashLastPaidBlock(),
+  hashListId(),
+  nListVersion(0),
+  mapListEntryVersion(),
+  mapKnownListDigests(),
   mAskedUsForMasternodeList(),
   mWeAskedForMasternodeList(),
   mWeAskedForMasternodeListEntry(),
+  cs_verify(),
   mWeAskedForVerification(),
+  mapVerifyRequestsInFlight(),
+  dequePendingMnv(),
+  nLastFullVerificationTime(0),
+  statsVerify(),
   mMnbRecoveryRequests(),
   mMnbRecoveryGoodReplies(),
   listScheduledMnbRequestConnections(),
@@ -114,6 +143,8 @@ CMasternodeMan::CMasternodeMan()
   fMasternodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  pListSnapshot(),
+  fListSnapshotDirty(true),
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
   nDsqCount(0)
@@ -127,6 +158,9 @@ bool CMasternodeMan::Add(CMasternode &mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        AddToLookupIndexes(vMasternodes.size() - 1);
+        ClearRankingCache();
+        MasternodeListEntryChanged(mn.vin.prevout);
         indexMasternodes.AddMasternodeVIN(mn.vin);
         fMasternodesAdded = true;
         return true;
@@ -171,8 +205,14 @@ void CMasternodeMan::Check()
     LogPrint("masternode", "CMasternodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        int nActiveStatePrev = mn.nActiveState;
         mn.Check();
+        if(mn.nActiveState != nActiveStatePrev) {
+            fListSnapshotDirty = true;
+        }
     }
+
+    PublishListSnapshot();
 }
 
 void CMasternodeMan::CheckAndRemove()
@@ -193,6 +233,8 @@ void CMasternodeMan::CheckAndRemove()
         std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES masternode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
+        // lookup indexes are rebuilt once after the loop, the ranking below doesn't use them
+        bool fLookupIndexesDirty = false;
         while(it != vMasternodes.end()) {
             CMasternodeBroadcast mnb = CMasternodeBroadcast(*it);
             uint256 hash = mnb.GetHash();
@@ -203,11 +245,15 @@ void CMasternodeMan::CheckAndRemove()
                 // erase all of the broadcasts we've seen from this txin, ...
                 mapSeenMasternodeBroadcast.erase(hash);
                 mWeAskedForMasternodeListEntry.erase((*it).vin.prevout);
+                mapListEntryVersion.erase((*it).vin.prevout);
 
                 // and finally remove it from the list
                 it->FlagGovernanceItemsAsDirty();
                 it = vMasternodes.erase(it);
+                ClearRankingCache();
+                fLookupIndexesDirty = true;
                 fMasternodesRemoved = true;
+                fListSnapshotDirty = true;
             } else {
                 bool fAsk = pCurrentBlockIndex &&
                             (nAskForMnbRecovery > 0) &&
@@ -244,6 +290,10 @@ void CMasternodeMan::CheckAndRemove()
             }
         }
 
+        if(fLookupIndexesDirty) {
+            RebuildLookupIndexes();
+        }
+
         // proces replies for MASTERNODE_NEW_START_REQUIRED masternodes
         LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- mMnbRecoveryGoodReplies size=%d\n", (int)mMnbRecoveryGoodReplies.size());
         std::map<uint256, std::vector<CMasternodeBroadcast> >::iterator itMnbReplies = mMnbRecoveryGoodReplies.begin();
@@ -300,6 +350,16 @@ void CMasternodeMan::CheckAndRemove()
             }
         }
 
+        // forget digests of lists we synced with long ago
+        std::map<CNetAddr, std::pair<CMasternodeListDigest, int64_t> >::iterator itDigest = mapKnownListDigests.begin();
+        while(itDigest != mapKnownListDigests.end()){
+            if(itDigest->second.second < GetTime()){
+                mapKnownListDigests.erase(itDigest++);
+            } else {
+                ++itDigest;
+            }
+        }
+
         // check which Masternodes we've asked for
         std::map<COutPoint, std::map<CNetAddr, int64_t> >::iterator it2 = mWeAskedForMasternodeListEntry.begin();
         while(it2 != mWeAskedForMasternodeListEntry.end()){
@@ -318,15 +378,6 @@ void CMasternodeMan::CheckAndRemove()
             }
         }
 
-        std::map<CNetAddr, CMasternodeVerification>::iterator it3 = mWeAskedForVerification.begin();
-        while(it3 != mWeAskedForVerification.end()){
-            if(it3->second.nBlockHeight < pCurrentBlockIndex->nHeight - MAX_POSE_BLOCKS) {
-                mWeAskedForVerification.erase(it3++);
-            } else {
-                ++it3;
-            }
-        }
-
         // NOTE: do not expire mapSeenMasternodeBroadcast entries here, clean them on mnb updates!
 
         // remove expired mapSeenMasternodePing
@@ -367,6 +418,11 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    mapMasternodeByOutpoint.clear();
+    mapMasternodeByPubKey.clear();
+    mapMasternodeByPayee.clear();
+    setPaymentQueue.clear();
+    ClearRankingCache();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -374,8 +430,15 @@ void CMasternodeMan::Clear()
     mapSeenMasternodePing.clear();
     nDsqCount = 0;
     nLastWatchdogVoteTime = 0;
+    mapPayeeLastPaid.clear();
+    hashLastPaidBlock = uint256();
+    hashListId = uint256();
+    nListVersion = 0;
+    mapListEntryVersion.clear();
+    mapKnownListDigests.clear();
     indexMasternodes.Clear();
     indexMasternodesOld.Clear();
+    fListSnapshotDirty = true;
 }
 
 int CMasternodeMan::CountMasternodes(int nProtocolVersion)
@@ -437,47 +500,149 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
         }
     }
     
-    pnode->PushMessage(NetMsgType::DSEG, CTxIn());
+    // if we still have the list we got from this peer last time, only ask for what changed since then
+    std::map<CNetAddr, std::pair<CMasternodeListDigest, int64_t> >::iterator itDigest = mapKnownListDigests.find(pnode->addr);
+    if(itDigest != mapKnownListDigests.end() && !vMasternodes.empty()) {
+        pnode->PushMessage(NetMsgType::DSEGDIFF, itDigest->second.first);
+    } else {
+        pnode->PushMessage(NetMsgType::DSEG, CTxIn());
+    }
     int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
 
     LogPrint("masternode", "CMasternodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
-CMasternode* CMasternodeMan::Find(const CScript &payee)
+void CMasternodeMan::MasternodeListEntryChanged(const COutPoint& outpoint)
+{
+    LOCK(cs);
+    if(hashListId.IsNull()) {
+        hashListId = GetRandHash();
+    }
+    mapListEntryVersion[outpoint] = ++nListVersion;
+    fListSnapshotDirty = true;
+}
+
+void CMasternodeMan::PublishListSnapshot()
 {
+    AssertLockHeld(cs);
+
+    CMasternodeListSnapshot_sptr pSnapshot = boost::atomic_load(&pListSnapshot);
+    if(pSnapshot && !fListSnapshotDirty && GetTime() - pSnapshot->nTime < LIST_SNAPSHOT_MAX_AGE_SECONDS) return;
+
+    boost::atomic_store(&pListSnapshot, CMasternodeListSnapshot_sptr(new CMasternodeListSnapshot(vMasternodes, GetTime())));
+    fListSnapshotDirty = false;
+}
+
+CMasternodeListSnapshot_sptr CMasternodeMan::GetListSnapshot()
+{
+    CMasternodeListSnapshot_sptr pSnapshot = boost::atomic_load(&pListSnapshot);
+    if(pSnapshot) return pSnapshot;
+
     LOCK(cs);
+    PublishListSnapshot();
+    return boost::atomic_load(&pListSnapshot);
+}
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
-            return &mn;
+void CMasternodeMan::AddToLookupIndexes(size_t nPos)
+{
+    const CMasternode& mn = vMasternodes[nPos];
+    mapMasternodeByOutpoint.insert(std::make_pair(mn.vin.prevout, nPos));
+    mapMasternodeByPubKey.insert(std::make_pair(mn.pubKeyMasternode, nPos));
+    mapMasternodeByPayee.insert(std::make_pair(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()), nPos));
+    setPaymentQueue.insert(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+}
+
+void CMasternodeMan::RebuildLookupIndexes()
+{
+    LOCK(cs);
+    mapMasternodeByOutpoint.clear();
+    mapMasternodeByPubKey.clear();
+    mapMasternodeByPayee.clear();
+    setPaymentQueue.clear();
+    for(size_t i = 0; i < vMasternodes.size(); ++i) {
+        AddToLookupIndexes(i);
     }
-    return NULL;
+    ClearRankingCache();
 }
 
-CMasternode* CMasternodeMan::Find(const CTxIn &vin)
+void CMasternodeMan::MasternodePubKeyChanged()
+{
+    // The previous key may still belong to another entry further down the list
+    RebuildLookupIndexes();
+}
+
+void CMasternodeMan::ClearRankingCache()
 {
     LOCK(cs);
+    mapRankingCache.clear();
+    listRankingCacheOrder.clear();
+}
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
+const std::vector<size_t>& CMasternodeMan::GetRanking(const uint256& blockHash)
+{
+    AssertLockHeld(cs);
+
+    std::map<uint256, std::vector<size_t> >::iterator it = mapRankingCache.find(blockHash);
+    if(it != mapRankingCache.end()) {
+        return it->second;
     }
-    return NULL;
+
+    while((int)listRankingCacheOrder.size() >= MAX_RANKING_CACHE_SIZE) {
+        mapRankingCache.erase(listRankingCacheOrder.front());
+        listRankingCacheOrder.pop_front();
+    }
+
+    arith_uint256 hashBlockHash = CMasternode::GetBlockHashScore(blockHash);
+    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
+    vecMasternodeScores.reserve(vMasternodes.size());
+    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        int64_t nScore = mn.CalculateScore(blockHash, hashBlockHash).GetCompact(false);
+        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
+    }
+
+    // CompareScoreMN is a strict total order, so filtering this ranking later
+    // gives the same order as sorting only the filtered masternodes
+    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
+
+    std::vector<size_t>& vecRanked = mapRankingCache[blockHash];
+    listRankingCacheOrder.push_back(blockHash);
+    vecRanked.reserve(vecMasternodeScores.size());
+    BOOST_FOREACH(PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores) {
+        vecRanked.push_back(s.second - &vMasternodes[0]);
+    }
+
+    return vecRanked;
+}
+
+CMasternode* CMasternodeMan::Find(const CScript &payee)
+{
+    LOCK(cs);
+
+    std::map<CScript, size_t>::iterator it = mapMasternodeByPayee.find(payee);
+    if(it == mapMasternodeByPayee.end())
+        return NULL;
+    return &vMasternodes[it->second];
+}
+
+CMasternode* CMasternodeMan::Find(const CTxIn &vin)
+{
+    LOCK(cs);
+
+    std::map<COutPoint, size_t>::iterator it = mapMasternodeByOutpoint.find(vin.prevout);
+    if(it == mapMasternodeByOutpoint.end())
+        return NULL;
+    return &vMasternodes[it->second];
 }
 
 CMasternode* CMasternodeMan::Find(const CPubKey &pubKeyMasternode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.pubKeyMasternode == pubKeyMasternode)
-            return &mn;
-    }
-    return NULL;
+    std::map<CPubKey, size_t>::iterator it = mapMasternodeByPubKey.find(pubKeyMasternode);
+    if(it == mapMasternodeByPubKey.end())
+        return NULL;
+    return &vMasternodes[it->second];
 }
 
 bool CMasternodeMan::Get(const CPubKey& pubKeyMasternode, CMasternode& masternode)
@@ -553,60 +718,76 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     LOCK2(cs_main,cs);
 
     CMasternode *pBestMasternode = NULL;
-    std::vector<std::pair<int, CMasternode*> > vecMasternodeLastPaid;
+
+    int nMnCount = CountEnabled();
+    int64_t nAdjustedTime = GetAdjustedTime();
+
+    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
+    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
+    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
+    //  -- (chance per block * chances before it gets scheduled)
+    int nTenthNetwork = std::max(nMnCount/10, 1);
+
+    // it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
+    std::set<CScript> setScheduledPayees;
+    mnpayments.GetScheduledPayees(nBlockHeight, setScheduledPayees);
 
     /*
-        Make a vector with all of the last paid times
+        Walk the queue from the oldest payment, counting the masternodes which qualify with
+        and without the sigTime filter and keeping the oldest tenth of each. This replaces
+        sorting all of them and, when the network is upgrading, doing it all over again.
     */
 
-    int nMnCount = CountEnabled();
-    BOOST_FOREACH(CMasternode &mn, vMasternodes)
+    std::vector<CMasternode*> vecOldest;
+    std::vector<CMasternode*> vecOldestAnySigTime;
+    int nCountAnySigTime = 0;
+    nCount = 0;
+    BOOST_FOREACH(const PAIRTYPE(int, COutPoint)& queued, setPaymentQueue)
     {
+        std::map<COutPoint, size_t>::iterator it = mapMasternodeByOutpoint.find(queued.second);
+        if(it == mapMasternodeByOutpoint.end()) continue;
+        CMasternode& mn = vMasternodes[it->second];
+
         if(!mn.IsValidForPayment()) continue;
 
         // //check protocol version
         if(mn.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
 
-        //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if(mnpayments.IsScheduled(mn, nBlockHeight)) continue;
-
-        //it's too new, wait for a cycle
-        if(fFilterSigTime && mn.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
+        if(!setScheduledPayees.empty() && setScheduledPayees.count(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()))) continue;
 
         //make sure it has at least as many confirmations as there are masternodes
         if(mn.GetCollateralAge() < nMnCount) continue;
 
-        vecMasternodeLastPaid.push_back(std::make_pair(mn.GetLastPaidBlock(), &mn));
-    }
+        //it's too new, wait for a cycle
+        if(!fFilterSigTime || mn.sigTime + (nMnCount*2.6*60) <= nAdjustedTime) {
+            if((int)vecOldest.size() < nTenthNetwork) vecOldest.push_back(&mn);
+            nCount++;
+        }
 
-    nCount = (int)vecMasternodeLastPaid.size();
+        if((int)vecOldestAnySigTime.size() < nTenthNetwork) vecOldestAnySigTime.push_back(&mn);
+        nCountAnySigTime++;
+    }
 
     //when the network is in the process of upgrading, don't penalize nodes that recently restarted
-    if(fFilterSigTime && nCount < nMnCount/3) return GetNextMasternodeInQueueForPayment(nBlockHeight, false, nCount);
-
-    // Sort them low to high
-    sort(vecMasternodeLastPaid.begin(), vecMasternodeLastPaid.end(), CompareLastPaidBlock());
+    if(fFilterSigTime && nCount < nMnCount/3) {
+        nCount = nCountAnySigTime;
+        vecOldest.swap(vecOldestAnySigTime);
+    }
 
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight - 101)) {
         LogPrintf("CMasternode::GetNextMasternodeInQueueForPayment -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", nBlockHeight - 101);
         return NULL;
     }
-    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
-    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
-    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
-    //  -- (chance per block * chances before IsScheduled will fire)
-    int nTenthNetwork = nMnCount/10;
-    int nCountTenth = 0;
+
     arith_uint256 nHighest = 0;
-    BOOST_FOREACH (PAIRTYPE(int, CMasternode*)& s, vecMasternodeLastPaid){
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
+    arith_uint256 hashBlockHash = CMasternode::GetBlockHashScore(blockHash);
+    BOOST_FOREACH(CMasternode* pmn, vecOldest) {
+        arith_uint256 nScore = pmn->CalculateScore(blockHash, hashBlockHash);
         if(nScore > nHighest){
             nHighest = nScore;
-            pBestMasternode = s.second;
+            pBestMasternode = pmn;
         }
-        nCountTenth++;
-        if(nCountTenth >= nTenthNetwork) break;
     }
     return pBestMasternode;
 }
@@ -656,16 +837,17 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToE
 
 int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
-
     //make sure we know about this block
     uint256 blockHash = uint256();
     if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    if(!Find(vin)) return -1;
+
+    int nRank = 0;
+    BOOST_FOREACH(size_t nPos, GetRanking(blockHash)) {
+        CMasternode& mn = vMasternodes[nPos];
         if(mn.nProtocolVersion < nMinProtocol) continue;
         if(fOnlyActive) {
             if(!mn.IsEnabled()) continue;
@@ -673,17 +855,8 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nM
         else {
             if(!mn.IsValidForPayment()) continue;
         }
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
-
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& scorePair, vecMasternodeScores) {
         nRank++;
-        if(scorePair.second->vin.prevout == vin.prevout) return nRank;
+        if(mn.vin.prevout == vin.prevout) return nRank;
     }
 
     return -1;
@@ -691,7 +864,6 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nM
 
 std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int nBlockHeight, int nMinProtocol)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
     std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
 
     //make sure we know about this block
@@ -700,22 +872,12 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
-
     int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores) {
+    BOOST_FOREACH(size_t nPos, GetRanking(blockHash)) {
+        CMasternode& mn = vMasternodes[nPos];
+        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
         nRank++;
-        vecMasternodeRanks.push_back(std::make_pair(nRank, *s.second));
+        vecMasternodeRanks.push_back(std::make_pair(nRank, mn));
     }
 
     return vecMasternodeRanks;
@@ -723,8 +885,6 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
-
     LOCK(cs);
 
     uint256 blockHash;
@@ -733,24 +893,14 @@ CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int nBlockHeight, in
         return NULL;
     }
 
-    // Fill scores
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-
+    int rank = 0;
+    BOOST_FOREACH(size_t nPos, GetRanking(blockHash)) {
+        CMasternode& mn = vMasternodes[nPos];
         if(mn.nProtocolVersion < nMinProtocol) continue;
         if(fOnlyActive && !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
-
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores){
         rank++;
         if(rank == nRank) {
-            return s.second;
+            return &mn;
         }
     }
 
@@ -814,15 +964,20 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         LogPrint("masternode", "MNANNOUNCE -- Masternode announce, masternode=%s\n", mnb.vin.prevout.ToStringShort());
 
-        int nDos = 0;
-
-        if (CheckMnbAndUpdateMasternodeList(pfrom, mnb, nDos)) {
-            // use announced Masternode as a peer
-            addrman.Add(CAddress(mnb.addr), pfrom->addr, 2*60*60);
-        } else if(nDos > 0) {
-            Misbehaving(pfrom->GetId(), nDos);
+        // during list sync broadcasts come in by the thousands, verify their signatures in batches
+        if (nScriptCheckThreads && !masternodeSync.IsMasternodeListSynced()) {
+            {
+                LOCK(cs);
+                pfrom->AddRef();
+                vecPendingMnb.push_back(std::make_pair(pfrom, mnb));
+                if (vecPendingMnb.size() < MNB_VERIFY_BATCH_SIZE) return;
+            }
+            ProcessPendingBroadcasts();
+            return;
         }
 
+        ProcessMasternodeBroadcast(pfrom, mnb);
+
         if(fMasternodesAdded) {
             NotifyMasternodeUpdates();
         }
@@ -866,19 +1021,27 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         // we might have to ask for a masternode entry once
         AskForMN(pfrom, mnp.vin);
 
-    } else if (strCommand == NetMsgType::DSEG) { //Get Masternode list or specific entry
+    } else if (strCommand == NetMsgType::DSEG || strCommand == NetMsgType::DSEGDIFF) { //Get Masternode list, list changes or specific entry
         // Ignore such requests until we are fully synced.
         // We could start processing this after masternode list is synced
         // but this is a heavy one so it's better to finish sync first.
         if (!masternodeSync.IsSynced()) return;
 
         CTxIn vin;
-        vRecv >> vin;
+        CMasternodeListDigest digestKnown;
+        if (strCommand == NetMsgType::DSEG) {
+            vRecv >> vin;
+        } else {
+            vRecv >> digestKnown;
+        }
 
-        LogPrint("masternode", "DSEG -- Masternode list, masternode=%s\n", vin.prevout.ToStringShort());
+        LogPrint("masternode", "DSEG -- Masternode list, masternode=%s, known version=%d\n", vin.prevout.ToStringShort(), digestKnown.nVersion);
 
         LOCK(cs);
 
+        // peer can only have a version of our current list, send everything otherwise
+        int64_t nSinceVersion = (!hashListId.IsNull() && digestKnown.hashListId == hashListId) ? digestKnown.nVersion : 0;
+
         if(vin == CTxIn()) { //only should ask for this once
             //local network
             bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
@@ -904,6 +1067,10 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             if (vin != CTxIn() && vin != mn.vin) continue; // asked for specific vin but we are not there yet
             if (mn.addr.IsRFC1918() || mn.addr.IsLocal()) continue; // do not send local network masternode
             if (mn.IsUpdateRequired()) continue; // do not send outdated masternodes
+            if (nSinceVersion > 0) {
+                std::map<COutPoint, int64_t>::iterator itVersion = mapListEntryVersion.find(mn.vin.prevout);
+                if (itVersion != mapListEntryVersion.end() && itVersion->second <= nSinceVersion) continue; // peer has it already
+            }
 
             LogPrint("masternode", "DSEG -- Sending Masternode entry: masternode=%s  addr=%s\n", mn.vin.prevout.ToStringShort(), mn.addr.ToString());
             CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
@@ -924,16 +1091,30 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         if(vin == CTxIn()) {
             pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_LIST, nInvCount);
-            LogPrintf("DSEG -- Sent %d Masternode invs to peer %d\n", nInvCount, pfrom->id);
+            // let peer ask for changes only next time
+            if(!hashListId.IsNull()) {
+                pfrom->PushMessage(NetMsgType::MNLISTDIGEST, CMasternodeListDigest(hashListId, nListVersion));
+            }
+            LogPrintf("DSEG -- Sent %d Masternode invs to peer %d (since version %d)\n", nInvCount, pfrom->id, nSinceVersion);
             return;
         }
         // smth weird happen - someone asked us for vin we have no idea about?
         LogPrint("masternode", "DSEG -- No invs sent to peer %d\n", pfrom->id);
 
-    } else if (strCommand == NetMsgType::MNVERIFY) { // Masternode Verify
+    } else if (strCommand == NetMsgType::MNLISTDIGEST) { // Digest of the Masternode list we just got
 
-        // Need LOCK2 here to ensure consistent locking order because the all functions below call GetBlockHash which locks cs_main
-        LOCK2(cs_main, cs);
+        CMasternodeListDigest digest;
+        vRecv >> digest;
+
+        LOCK(cs);
+
+        // only remember digests of lists we asked for
+        if(!mWeAskedForMasternodeList.count(pfrom->addr)) return;
+
+        LogPrint("masternode", "MNLISTDIGEST -- peer=%d  version=%d\n", pfrom->id, digest.nVersion);
+        mapKnownListDigests[pfrom->addr] = std::make_pair(digest, GetTime() + LIST_DIGEST_EXPIRE_SECONDS);
+
+    } else if (strCommand == NetMsgType::MNVERIFY) { // Masternode Verify
 
         CMasternodeVerification mnv;
         vRecv >> mnv;
@@ -941,28 +1122,121 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         if(mnv.vchSig1.empty()) {
             // CASE 1: someone asked me to verify myself /IP we are using/
             SendVerifyReply(pfrom, mnv);
-        } else if (mnv.vchSig2.empty()) {
-            // CASE 2: we _probably_ got verification we requested from some masternode
-            ProcessVerifyReply(pfrom, mnv);
-        } else {
-            // CASE 3: we _probably_ got verification broadcast signed by some masternode which verified another one
-            ProcessVerifyBroadcast(pfrom, mnv);
+            return;
+        }
+
+        // CASE 2: we _probably_ got verification we requested from some masternode
+        // CASE 3: we _probably_ got verification broadcast signed by some masternode which verified another one
+        // Both are checked by the verification worker, see ProcessPendingVerifications()
+        LOCK(cs_verify);
+        if(dequePendingMnv.size() >= MAX_POSE_PENDING_MESSAGES) {
+            LogPrint("masternode", "MNVERIFY -- too many pending verifications, dropping, peer=%d\n", pfrom->id);
+            statsVerify.nMessagesDropped++;
+            return;
         }
+        pfrom->AddRef();
+        dequePendingMnv.push_back(std::make_pair(pfrom, mnv));
     }
 }
 
 // Verification of masternodes via unique direct requests.
 
+void CMasternodeMan::ScheduleVerification(CScheduler& scheduler)
+{
+    scheduler.scheduleEvery(boost::bind(&CMasternodeMan::DoVerificationWork, this), POSE_VERIFY_TICK_SECONDS);
+}
+
+void CMasternodeMan::DoVerificationWork()
+{
+    if(fLiteMode || !masternodeSync.IsBlockchainSynced()) return;
+
+    ProcessPendingVerifications();
+    CheckVerificationRequests();
+
+    if(!fMasterNode) return;
+
+    {
+        LOCK(cs_verify);
+        if(GetTime() - nLastFullVerificationTime < POSE_VERIFY_STEP_SECONDS) return;
+        nLastFullVerificationTime = GetTime();
+    }
+
+    DoFullVerificationStep();
+}
+
+void CMasternodeMan::ProcessPendingVerifications()
+{
+    std::vector<std::pair<CNode*, CMasternodeVerification> > vecMnv;
+    {
+        LOCK(cs_verify);
+        while(!dequePendingMnv.empty() && vecMnv.size() < MAX_POSE_VERIFY_BATCH_SIZE) {
+            vecMnv.push_back(dequePendingMnv.front());
+            dequePendingMnv.pop_front();
+        }
+    }
+
+    if(vecMnv.empty()) return;
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    BOOST_FOREACH(PAIRTYPE(CNode*, CMasternodeVerification)& pair, vecMnv) {
+        if(pair.second.vchSig2.empty()) {
+            ProcessVerifyReply(pair.first, pair.second);
+        } else {
+            ProcessVerifyBroadcast(pair.first, pair.second);
+        }
+        pair.first->Release();
+    }
+
+    LogPrint("masternode", "CMasternodeMan::ProcessPendingVerifications -- %d verifications processed in %.2fms\n",
+              vecMnv.size(), 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
+void CMasternodeMan::CheckVerificationRequests()
+{
+    LOCK(cs_verify);
+
+    std::map<CNetAddr, CMasternodeVerification>::iterator it = mWeAskedForVerification.begin();
+    while(it != mWeAskedForVerification.end()) {
+        if(it->second.nBlockHeight < nCachedBlockHeight - MAX_POSE_BLOCKS) {
+            mWeAskedForVerification.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    std::map<CNetAddr, int64_t>::iterator it2 = mapVerifyRequestsInFlight.begin();
+    while(it2 != mapVerifyRequestsInFlight.end()) {
+        if(GetTime() - it2->second > POSE_VERIFY_TIMEOUT_SECONDS) {
+            LogPrint("masternode", "CMasternodeMan::CheckVerificationRequests -- no reply from %s\n", it2->first.ToString());
+            statsVerify.nRequestsTimedOut++;
+            mapVerifyRequestsInFlight.erase(it2++);
+        } else {
+            ++it2;
+        }
+    }
+}
+
 void CMasternodeMan::DoFullVerificationStep()
 {
     if(activeMasternode.vin == CTxIn()) return;
     if(!masternodeSync.IsSynced()) return;
 
-    std::vector<std::pair<int, CMasternode> > vecMasternodeRanks = GetMasternodeRanks(pCurrentBlockIndex->nHeight - 1, MIN_POSE_PROTO_VERSION);
+    int nMaxCount;
+    {
+        LOCK(cs_verify);
+        nMaxCount = std::min((int)MAX_POSE_CONNECTIONS, MAX_POSE_REQUESTS_IN_FLIGHT - (int)mapVerifyRequestsInFlight.size());
+    }
+    if(nMaxCount <= 0) {
+        LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- %d requests in flight already, skipping\n",
+                    (int)MAX_POSE_REQUESTS_IN_FLIGHT);
+        return;
+    }
 
-    // Need LOCK2 here to ensure consistent locking order because the SendVerifyRequest call below locks cs_main
-    // through GetHeight() signal in ConnectNode
-    LOCK2(cs_main, cs);
+    // Work on a copy of the ranking, so that neither cs nor cs_main are held
+    // while we connect to the masternodes being verified
+    int nBlockHeight = nCachedBlockHeight - 1;
+    std::vector<std::pair<int, CMasternode> > vecMasternodeRanks = GetMasternodeRanks(nBlockHeight, MIN_POSE_PROTO_VERSION);
 
     int nCount = 0;
 
@@ -980,7 +1254,7 @@ void CMasternodeMan::DoFullVerificationStep()
         if(it->second.vin == activeMasternode.vin) {
             nMyRank = it->first;
             LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- Found self at rank %d/%d, verifying up to %d masternodes\n",
-                        nMyRank, nRanksTotal, (int)MAX_POSE_CONNECTIONS);
+                        nMyRank, nRanksTotal, nMaxCount);
             break;
         }
         ++it;
@@ -989,18 +1263,11 @@ void CMasternodeMan::DoFullVerificationStep()
     // edge case: list is too short and this masternode is not enabled
     if(nMyRank == -1) return;
 
-    // send verify requests to up to MAX_POSE_CONNECTIONS masternodes
+    // send verify requests to up to nMaxCount masternodes
     // starting from MAX_POSE_RANK + nMyRank and using MAX_POSE_CONNECTIONS as a step
     int nOffset = MAX_POSE_RANK + nMyRank - 1;
     if(nOffset >= (int)vecMasternodeRanks.size()) return;
 
-    std::vector<CMasternode*> vSortedByAddr;
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        vSortedByAddr.push_back(&mn);
-    }
-
-    sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
     it = vecMasternodeRanks.begin() + nOffset;
     while(it != vecMasternodeRanks.end()) {
         if(it->second.IsPoSeVerified() || it->second.IsPoSeBanned()) {
@@ -1016,9 +1283,9 @@ void CMasternodeMan::DoFullVerificationStep()
         }
         LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- Verifying masternode %s rank %d/%d address %s\n",
                     it->second.vin.prevout.ToStringShort(), it->first, nRanksTotal, it->second.addr.ToString());
-        if(SendVerifyRequest((CAddress)it->second.addr, vSortedByAddr)) {
+        if(SendVerifyRequest((CAddress)it->second.addr, nBlockHeight)) {
             nCount++;
-            if(nCount >= MAX_POSE_CONNECTIONS) break;
+            if(nCount >= nMaxCount) break;
         }
         nOffset += MAX_POSE_CONNECTIONS;
         if(nOffset >= (int)vecMasternodeRanks.size()) break;
@@ -1086,7 +1353,7 @@ void CMasternodeMan::CheckSameAddr()
     }
 }
 
-bool CMasternodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<CMasternode*>& vSortedByAddr)
+bool CMasternodeMan::SendVerifyRequest(const CAddress& addr, int nBlockHeight)
 {
     if(netfulfilledman.HasFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
         // we already asked for verification, not a good idea to do this too often, skip it
@@ -1102,8 +1369,13 @@ bool CMasternodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<C
 
     netfulfilledman.AddFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request");
     // use random nonce, store it and require node to reply with correct one later
-    CMasternodeVerification mnv(addr, GetRandInt(999999), pCurrentBlockIndex->nHeight - 1);
-    mWeAskedForVerification[addr] = mnv;
+    CMasternodeVerification mnv(addr, GetRandInt(999999), nBlockHeight);
+    {
+        LOCK(cs_verify);
+        mWeAskedForVerification[addr] = mnv;
+        mapVerifyRequestsInFlight[addr] = GetTime();
+        statsVerify.nRequestsSent++;
+    }
     LogPrintf("CMasternodeMan::SendVerifyRequest -- verifying node using nonce %d addr=%s\n", mnv.nonce, addr.ToString());
     pnode->PushMessage(NetMsgType::MNVERIFY, mnv);
 
@@ -1122,6 +1394,7 @@ void CMasternodeMan::SendVerifyReply(CNode* pnode, CMasternodeVerification& mnv)
     if(netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-reply")) {
         // peer should not ask us that often
         LogPrintf("MasternodeMan::SendVerifyReply -- ERROR: peer already asked me recently, peer=%d\n", pnode->id);
+        LOCK(cs_main);
         Misbehaving(pnode->id, 20);
         return;
     }
@@ -1157,22 +1430,36 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
     // did we even ask for it? if that's the case we should have matching fulfilled request
     if(!netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
         LogPrintf("CMasternodeMan::ProcessVerifyReply -- ERROR: we didn't ask for verification of %s, peer=%d\n", pnode->addr.ToString(), pnode->id);
+        LOCK(cs_main);
         Misbehaving(pnode->id, 20);
         return;
     }
 
+    CMasternodeVerification mnvRequest;
+    {
+        LOCK(cs_verify);
+        std::map<CNetAddr, CMasternodeVerification>::iterator it = mWeAskedForVerification.find(pnode->addr);
+        if(it != mWeAskedForVerification.end()) {
+            mnvRequest = it->second;
+        }
+        // the peer answered, so this request no longer counts against the in-flight limit
+        mapVerifyRequestsInFlight.erase(pnode->addr);
+    }
+
     // Received nonce for a known address must match the one we sent
-    if(mWeAskedForVerification[pnode->addr].nonce != mnv.nonce) {
+    if(mnvRequest.nonce != mnv.nonce) {
         LogPrintf("CMasternodeMan::ProcessVerifyReply -- ERROR: wrong nounce: requested=%d, received=%d, peer=%d\n",
-                    mWeAskedForVerification[pnode->addr].nonce, mnv.nonce, pnode->id);
+                    mnvRequest.nonce, mnv.nonce, pnode->id);
+        LOCK(cs_main);
         Misbehaving(pnode->id, 20);
         return;
     }
 
     // Received nBlockHeight for a known address must match the one we sent
-    if(mWeAskedForVerification[pnode->addr].nBlockHeight != mnv.nBlockHeight) {
+    if(mnvRequest.nBlockHeight != mnv.nBlockHeight) {
         LogPrintf("CMasternodeMan::ProcessVerifyReply -- ERROR: wrong nBlockHeight: requested=%d, received=%d, peer=%d\n",
-                    mWeAskedForVerification[pnode->addr].nBlockHeight, mnv.nBlockHeight, pnode->id);
+                    mnvRequest.nBlockHeight, mnv.nBlockHeight, pnode->id);
+        LOCK(cs_main);
         Misbehaving(pnode->id, 20);
         return;
     }
@@ -1187,92 +1474,119 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
     // we already verified this address, why node is spamming?
     if(netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done")) {
         LogPrintf("CMasternodeMan::ProcessVerifyReply -- ERROR: already verified %s recently\n", pnode->addr.ToString());
+        LOCK(cs_main);
         Misbehaving(pnode->id, 20);
         return;
     }
 
+    // Copy the masternodes using this address and check their signatures without holding cs
+    std::vector<CMasternode> vecCandidates;
     {
         LOCK(cs);
+        BOOST_FOREACH(const CMasternode& mn, vMasternodes) {
+            if((CAddress)mn.addr == pnode->addr) {
+                vecCandidates.push_back(mn);
+            }
+        }
+    }
 
-        CMasternode* prealMasternode = NULL;
-        std::vector<CMasternode*> vpMasternodesToBan;
-        std::vector<CMasternode>::iterator it = vMasternodes.begin();
-        std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(false), mnv.nonce, blockHash.ToString());
-        while(it != vMasternodes.end()) {
-            if((CAddress)it->addr == pnode->addr) {
-                if(darkSendSigner.VerifyMessage(it->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
-                    // found it!
-                    prealMasternode = &(*it);
-                    if(!it->IsPoSeVerified()) {
-                        it->DecreasePoSeBanScore();
-                    }
-                    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
-
-                    // we can only broadcast it if we are an activated masternode
-                    if(activeMasternode.vin == CTxIn()) continue;
-                    // update ...
-                    mnv.addr = it->addr;
-                    mnv.vin1 = it->vin;
-                    mnv.vin2 = activeMasternode.vin;
-                    std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
-                                            mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
-                    // ... and sign it
-                    if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeMasternode.keyMasternode)) {
-                        LogPrintf("MasternodeMan::ProcessVerifyReply -- SignMessage() failed\n");
-                        return;
-                    }
-
-                    std::string strError;
+    const CMasternode* prealMasternode = NULL;
+    std::vector<const CMasternode*> vpMasternodesVerified;
+    std::vector<const CMasternode*> vpMasternodesToBan;
+    std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(false), mnv.nonce, blockHash.ToString());
+    BOOST_FOREACH(const CMasternode& mn, vecCandidates) {
+        if(darkSendSigner.VerifyMessage(mn.pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
+            // found it!
+            prealMasternode = &mn;
+            vpMasternodesVerified.push_back(&mn);
+        } else {
+            vpMasternodesToBan.push_back(&mn);
+        }
+    }
 
-                    if(!darkSendSigner.VerifyMessage(activeMasternode.pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
-                        LogPrintf("MasternodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
-                        return;
-                    }
+    // no real masternode found?...
+    if(!prealMasternode) {
+        // this should never be the case normally,
+        // only if someone is trying to game the system in some way or smth like that
+        LogPrintf("CMasternodeMan::ProcessVerifyReply -- ERROR: no real masternode found for addr %s\n", pnode->addr.ToString());
+        LOCK(cs_main);
+        Misbehaving(pnode->id, 20);
+        return;
+    }
 
-                    mWeAskedForVerification[pnode->addr] = mnv;
-                    mnv.Relay();
+    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
 
-                } else {
-                    vpMasternodesToBan.push_back(&(*it));
-                }
+    {
+        LOCK(cs);
+        BOOST_FOREACH(const CMasternode* pmnVerified, vpMasternodesVerified) {
+            CMasternode* pmn = Find(pmnVerified->vin);
+            if(pmn && !pmn->IsPoSeVerified()) {
+                pmn->DecreasePoSeBanScore();
             }
-            ++it;
         }
-        // no real masternode found?...
-        if(!prealMasternode) {
-            // this should never be the case normally,
-            // only if someone is trying to game the system in some way or smth like that
-            LogPrintf("CMasternodeMan::ProcessVerifyReply -- ERROR: no real masternode found for addr %s\n", pnode->addr.ToString());
-            Misbehaving(pnode->id, 20);
-            return;
-        }
-        LogPrintf("CMasternodeMan::ProcessVerifyReply -- verified real masternode %s for addr %s\n",
-                    prealMasternode->vin.prevout.ToStringShort(), pnode->addr.ToString());
         // increase ban score for everyone else
-        BOOST_FOREACH(CMasternode* pmn, vpMasternodesToBan) {
+        BOOST_FOREACH(const CMasternode* pmnToBan, vpMasternodesToBan) {
+            CMasternode* pmn = Find(pmnToBan->vin);
+            if(!pmn) continue;
             pmn->IncreasePoSeBanScore();
-            LogPrint("masternode", "CMasternodeMan::ProcessVerifyBroadcast -- increased PoSe ban score for %s addr %s, new score %d\n",
-                        prealMasternode->vin.prevout.ToStringShort(), pnode->addr.ToString(), pmn->nPoSeBanScore);
+            LogPrint("masternode", "CMasternodeMan::ProcessVerifyReply -- increased PoSe ban score for %s addr %s, new score %d\n",
+                        pmn->vin.prevout.ToStringShort(), pnode->addr.ToString(), pmn->nPoSeBanScore);
         }
-        LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- PoSe score increased for %d fake masternodes, addr %s\n",
-                    (int)vpMasternodesToBan.size(), pnode->addr.ToString());
     }
+
+    LogPrintf("CMasternodeMan::ProcessVerifyReply -- verified real masternode %s for addr %s\n",
+                prealMasternode->vin.prevout.ToStringShort(), pnode->addr.ToString());
+    LogPrintf("CMasternodeMan::ProcessVerifyReply -- PoSe score increased for %d fake masternodes, addr %s\n",
+                (int)vpMasternodesToBan.size(), pnode->addr.ToString());
+
+    {
+        LOCK(cs_verify);
+        statsVerify.nRepliesVerified++;
+    }
+
+    // we can only broadcast it if we are an activated masternode
+    if(activeMasternode.vin == CTxIn()) return;
+    // update ...
+    mnv.addr = prealMasternode->addr;
+    mnv.vin1 = prealMasternode->vin;
+    mnv.vin2 = activeMasternode.vin;
+    std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
+                            mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+    // ... and sign it
+    if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeMasternode.keyMasternode)) {
+        LogPrintf("MasternodeMan::ProcessVerifyReply -- SignMessage() failed\n");
+        return;
+    }
+
+    if(!darkSendSigner.VerifyMessage(activeMasternode.pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
+        LogPrintf("MasternodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
+        return;
+    }
+
+    {
+        LOCK(cs_verify);
+        mWeAskedForVerification[pnode->addr] = mnv;
+    }
+    mnv.Relay();
 }
 
 void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerification& mnv)
 {
     std::string strError;
 
-    if(mapSeenMasternodeVerification.find(mnv.GetHash()) != mapSeenMasternodeVerification.end()) {
-        // we already have one
-        return;
+    {
+        LOCK(cs);
+        if(mapSeenMasternodeVerification.find(mnv.GetHash()) != mapSeenMasternodeVerification.end()) {
+            // we already have one
+            return;
+        }
+        mapSeenMasternodeVerification[mnv.GetHash()] = mnv;
     }
-    mapSeenMasternodeVerification[mnv.GetHash()] = mnv;
 
     // we don't care about history
-    if(mnv.nBlockHeight < pCurrentBlockIndex->nHeight - MAX_POSE_BLOCKS) {
+    if(mnv.nBlockHeight < nCachedBlockHeight - MAX_POSE_BLOCKS) {
         LogPrint("masternode", "MasternodeMan::ProcessVerifyBroadcast -- Outdated: current block %d, verification block %d, peer=%d\n",
-                    pCurrentBlockIndex->nHeight, mnv.nBlockHeight, pnode->id);
+                    (int)nCachedBlockHeight, mnv.nBlockHeight, pnode->id);
         return;
     }
 
@@ -1281,6 +1595,7 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
                     mnv.vin1.prevout.ToStringShort(), pnode->id);
         // that was NOT a good idea to cheat and verify itself,
         // ban the node we received such message from
+        LOCK(cs_main);
         Misbehaving(pnode->id, 100);
         return;
     }
@@ -1306,13 +1621,12 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
         return;
     }
 
+    // Copy what we need from both masternodes and check the signatures without holding cs
+    CPubKey pubKeyMasternode1;
+    CPubKey pubKeyMasternode2;
     {
         LOCK(cs);
 
-        std::string strMessage1 = strprintf("%s%d%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString());
-        std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
-                                mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
-
         CMasternode* pmn1 = Find(mnv.vin1);
         if(!pmn1) {
             LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- can't find masternode1 %s\n", mnv.vin1.prevout.ToStringShort());
@@ -1330,26 +1644,39 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
             return;
         }
 
-        if(darkSendSigner.VerifyMessage(pmn1->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
-            LogPrintf("MasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode1 failed, error: %s\n", strError);
-            return;
-        }
+        pubKeyMasternode1 = pmn1->pubKeyMasternode;
+        pubKeyMasternode2 = pmn2->pubKeyMasternode;
+    }
 
-        if(darkSendSigner.VerifyMessage(pmn2->pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
-            LogPrintf("MasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode2 failed, error: %s\n", strError);
-            return;
-        }
+    std::string strMessage1 = strprintf("%s%d%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString());
+    std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
+                            mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+
+    if(!darkSendSigner.VerifyMessage(pubKeyMasternode1, mnv.vchSig1, strMessage1, strError)) {
+        LogPrintf("MasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode1 failed, error: %s\n", strError);
+        return;
+    }
+
+    if(!darkSendSigner.VerifyMessage(pubKeyMasternode2, mnv.vchSig2, strMessage2, strError)) {
+        LogPrintf("MasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode2 failed, error: %s\n", strError);
+        return;
+    }
+
+    int nCount = 0;
+    {
+        LOCK(cs);
+
+        CMasternode* pmn1 = Find(mnv.vin1);
+        if(!pmn1) return;
 
         if(!pmn1->IsPoSeVerified()) {
             pmn1->DecreasePoSeBanScore();
         }
-        mnv.Relay();
 
         LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- verified masternode %s for addr %s\n",
                     pmn1->vin.prevout.ToStringShort(), pnode->addr.ToString());
 
         // increase ban score for everyone else with the same addr
-        int nCount = 0;
         BOOST_FOREACH(CMasternode& mn, vMasternodes) {
             if(mn.addr != mnv.addr || mn.vin.prevout == mnv.vin1.prevout) continue;
             mn.IncreasePoSeBanScore();
@@ -1357,9 +1684,21 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
             LogPrint("masternode", "CMasternodeMan::ProcessVerifyBroadcast -- increased PoSe ban score for %s addr %s, new score %d\n",
                         mn.vin.prevout.ToStringShort(), mn.addr.ToString(), mn.nPoSeBanScore);
         }
-        LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- PoSe score incresed for %d fake masternodes, addr %s\n",
-                    nCount, pnode->addr.ToString());
     }
+    LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- PoSe score incresed for %d fake masternodes, addr %s\n",
+                nCount, pnode->addr.ToString());
+
+    {
+        LOCK(cs_verify);
+        statsVerify.nBroadcastsVerified++;
+    }
+    mnv.Relay();
+}
+
+std::string CMasternodeVerificationStats::ToString() const
+{
+    return strprintf("requests sent %d, timed out %d, replies verified %d, broadcasts verified %d, dropped %d",
+                     nRequestsSent, nRequestsTimedOut, nRepliesVerified, nBroadcastsVerified, nMessagesDropped);
 }
 
 std::string CMasternodeMan::ToString() const
@@ -1373,6 +1712,13 @@ std::string CMasternodeMan::ToString() const
             ", masternode index size: " << indexMasternodes.GetSize() <<
             ", nDsqCount: " << (int)nDsqCount;
 
+    {
+        LOCK(cs_verify);
+        info << ", verification requests in flight: " << (int)mapVerifyRequestsInFlight.size() <<
+                ", pending verifications: " << (int)dequePendingMnv.size() <<
+                ", verification stats: " << statsVerify.ToString();
+    }
+
     return info.str();
 }
 
@@ -1399,6 +1745,61 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
     }
 }
 
+void CMasternodeMan::ProcessMasternodeBroadcast(CNode* pfrom, CMasternodeBroadcast& mnb)
+{
+    int nDos = 0;
+
+    if (CheckMnbAndUpdateMasternodeList(pfrom, mnb, nDos)) {
+        // use announced Masternode as a peer
+        addrman.Add(CAddress(mnb.addr), pfrom->addr, 2*60*60);
+    } else if(nDos > 0) {
+        Misbehaving(pfrom->GetId(), nDos);
+    }
+}
+
+void CMasternodeMan::ProcessPendingBroadcasts()
+{
+    LOCK(cs_pendingmnb);
+
+    std::vector<std::pair<CNode*, CMasternodeBroadcast> > vecMnb;
+    {
+        LOCK(cs);
+        vecMnb.swap(vecPendingMnb);
+    }
+    if(vecMnb.empty()) return;
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    // verify all signatures of the batch at once on the signature check threads ...
+    {
+        std::vector<CMasternodeSignatureCheck> vChecks;
+        vChecks.reserve(vecMnb.size() * 2);
+        BOOST_FOREACH(const PAIRTYPE(CNode*, CMasternodeBroadcast)& pair, vecMnb) {
+            const CMasternodeBroadcast& mnb = pair.second;
+            vChecks.push_back(CMasternodeSignatureCheck(mnb.pubKeyCollateralAddress, mnb.vchSig, mnb.GetSignatureMessage()));
+            if(mnb.lastPing != CMasternodePing()) {
+                vChecks.push_back(CMasternodeSignatureCheck(mnb.pubKeyMasternode, mnb.lastPing.vchSig, mnb.lastPing.GetSignatureMessage()));
+            }
+        }
+        VerifyMasternodeSignatures(vChecks);
+    }
+
+    int64_t nTimeVerified = GetTimeMicros();
+
+    // ... then process them one by one, their signature checks are cached now
+    BOOST_FOREACH(PAIRTYPE(CNode*, CMasternodeBroadcast)& pair, vecMnb) {
+        ProcessMasternodeBroadcast(pair.first, pair.second);
+        pair.first->Release();
+    }
+
+    LogPrint("masternode", "CMasternodeMan::ProcessPendingBroadcasts -- %d broadcasts, verified in %.2fms, processed in %.2fms\n",
+              vecMnb.size(), 0.001 * (nTimeVerified - nTimeStart), 0.001 * (GetTimeMicros() - nTimeVerified));
+
+    if(fMasternodesAdded) {
+        NotifyMasternodeUpdates();
+    }
+}
+
 bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos)
 {
     // Need LOCK2 here to ensure consistent locking order because the SimpleCheck call below locks cs_main
@@ -1490,25 +1891,223 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
 
 void CMasternodeMan::UpdateLastPaid()
 {
-    LOCK(cs);
+    // Need LOCK2 here to ensure consistent locking order because ConnectLastPaidBlock is called with cs_main held
+    LOCK2(cs_main, cs);
 
     if(fLiteMode) return;
     if(!pCurrentBlockIndex) return;
 
-    static bool IsFirstRun = true;
-    // Do full scan on first run or if we are not a masternode
-    // (MNs should update this info on every block, so limited scan should be enough for them)
-    int nMaxBlocksToScanBack = (IsFirstRun || !fMasterNode) ? mnpayments.GetStorageLimit() : LAST_PAID_SCAN_BLOCKS;
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    int nMaxBlocksToScanBack = mnpayments.GetStorageLimit();
+
+    // Blocks connected while the index was not kept up to date (before mncache.dat
+    // was loaded or by a crashed node) are read back from disk. If the index is
+    // unknown, on a stale fork or too far behind, start over from the same window
+    // a full scan used to cover.
+    BlockMap::iterator mi = mapBlockIndex.find(hashLastPaidBlock);
+    const CBlockIndex* pindexLastPaid = (mi != mapBlockIndex.end()) ? mi->second : NULL;
+    if(!pindexLastPaid ||
+       pindexTip->GetAncestor(pindexLastPaid->nHeight) != pindexLastPaid ||
+       pindexTip->nHeight - pindexLastPaid->nHeight > nMaxBlocksToScanBack) {
+        mapPayeeLastPaid.clear();
+        pindexLastPaid = pindexTip->GetAncestor(std::max(0, pindexTip->nHeight - nMaxBlocksToScanBack));
+        hashLastPaidBlock = pindexLastPaid->GetBlockHash();
+    }
+
+    if(pindexLastPaid != pindexTip) {
+        LogPrint("masternode", "CMasternodeMan::UpdateLastPaid -- reading %d blocks\n", pindexTip->nHeight - pindexLastPaid->nHeight);
+    }
+    while(pindexLastPaid != pindexTip) {
+        const CBlockIndex* pindex = pindexTip->GetAncestor(pindexLastPaid->nHeight + 1);
+        CBlock block;
+        if(ReadBlockFromDisk(block, pindex)) {
+            ConnectLastPaidBlock(block, pindex);
+        } else {
+            // pruned, nothing to learn from it
+            hashLastPaidBlock = pindex->GetBlockHash();
+        }
+        pindexLastPaid = pindex;
+    }
 
-    // LogPrint("mnpayments", "CMasternodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
-    //                         pCurrentBlockIndex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
+    // Payments older than the scan window were never looked at before either
+    std::map<CKeyID, std::vector<std::pair<int, int64_t> > >::iterator it = mapPayeeLastPaid.begin();
+    while(it != mapPayeeLastPaid.end()) {
+        if(it->second.back().first < pindexTip->nHeight - nMaxBlocksToScanBack) {
+            mapPayeeLastPaid.erase(it++);
+        } else {
+            ++it;
+        }
+    }
 
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        mn.UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
+        it = mapPayeeLastPaid.find(mn.pubKeyCollateralAddress.GetID());
+        if(it != mapPayeeLastPaid.end()) {
+            SetLastPaid(mn, it->second.back().first, it->second.back().second);
+        }
     }
 
-    // every time is like the first time if winners list is not synced
-    IsFirstRun = !masternodeSync.IsWinnersListSynced();
+    // readers of the snapshot (masternodelist, Qt) expect the values just updated
+    fListSnapshotDirty = true;
+    PublishListSnapshot();
+}
+
+void CMasternodeMan::SetLastPaid(CMasternode& mn, int nBlockLastPaidIn, int64_t nTimeLastPaidIn)
+{
+    AssertLockHeld(cs);
+
+    // keep the payment queue ordered
+    if(setPaymentQueue.erase(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout))) {
+        setPaymentQueue.insert(std::make_pair(nBlockLastPaidIn, mn.vin.prevout));
+    }
+    mn.UpdateLastPaid(nBlockLastPaidIn, nTimeLastPaidIn);
+}
+
+void CMasternodeMan::BlockConnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+
+    nCachedBlockHeight = pindex->nHeight;
+
+    ConnectLastPaidBlock(block, pindex);
+    fListSnapshotDirty = true;
+
+    // collateral of masternodes we couldn't find it for may have just been confirmed
+    std::set<uint256> setTxHashes;
+    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        if(mn.nCacheCollateralBlock != 0) continue;
+        if(setTxHashes.empty()) {
+            BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+                setTxHashes.insert(tx.GetHash());
+            }
+        }
+        if(setTxHashes.count(mn.vin.prevout.hash)) {
+            mn.nCacheCollateralBlock = pindex->nHeight;
+        }
+    }
+}
+
+void CMasternodeMan::BlockDisconnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+
+    nCachedBlockHeight = pindex->nHeight - 1;
+
+    DisconnectLastPaidBlock(block, pindex);
+    fListSnapshotDirty = true;
+
+    // collateral which was confirmed in this block is not anymore
+    std::set<uint256> setTxHashes;
+    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        if(mn.nCacheCollateralBlock != pindex->nHeight) continue;
+        if(setTxHashes.empty()) {
+            BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+                setTxHashes.insert(tx.GetHash());
+            }
+        }
+        if(setTxHashes.count(mn.vin.prevout.hash)) {
+            mn.nCacheCollateralBlock = 0;
+        }
+    }
+}
+
+void CMasternodeMan::ResolveCollateralHeights()
+{
+    {
+        LOCK(cs);
+        bool fUnresolved = false;
+        BOOST_FOREACH(const CMasternode& mn, vMasternodes) {
+            if(mn.nCacheCollateralBlock == 0) {
+                fUnresolved = true;
+                break;
+            }
+        }
+        // nothing to look up, don't bother cs_main
+        if(!fUnresolved) return;
+    }
+
+    LOCK2(cs_main, cs);
+
+    int nResolved = 0;
+    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        if(mn.nCacheCollateralBlock != 0) continue;
+        CCoins coins;
+        if(pcoinsTip->GetCoins(mn.vin.prevout.hash, coins) && coins.nHeight > 0) {
+            mn.nCacheCollateralBlock = coins.nHeight;
+            nResolved++;
+        }
+    }
+
+    LogPrint("masternode", "CMasternodeMan::ResolveCollateralHeights -- resolved %d collateral heights\n", nResolved);
+}
+
+void CMasternodeMan::ConnectLastPaidBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs);
+
+    // Not the next block for the index, UpdateLastPaid will catch up
+    if(!pindex->pprev || hashLastPaidBlock != pindex->pprev->GetBlockHash()) return;
+
+    CAmount nMasternodePayment = GetMasternodePayment(pindex->nHeight, block.vtx[0].GetValueOut());
+
+    // Only credit payees the payment votes selected for this block, an output
+    // of the right amount alone could be paid to any address by the miner.
+    LOCK(cs_mapMasternodeBlocks);
+    std::map<int, CMasternodeBlockPayees>::iterator itBlock = mnpayments.mapMasternodeBlocks.find(pindex->nHeight);
+
+    if(nMasternodePayment > 0 && itBlock != mnpayments.mapMasternodeBlocks.end()) {
+        BOOST_FOREACH(const CTxOut& txout, block.vtx[0].vout) {
+            CTxDestination dest;
+            if(txout.nValue != nMasternodePayment || !itBlock->second.HasPayeeWithVotes(txout.scriptPubKey, 2)) continue;
+            if(!ExtractDestination(txout.scriptPubKey, dest)) continue;
+            const CKeyID* pkeyID = boost::get<CKeyID>(&dest);
+            if(!pkeyID) continue;
+            std::vector<std::pair<int, int64_t> >& vecPaid = mapPayeeLastPaid[*pkeyID];
+            vecPaid.push_back(std::make_pair(pindex->nHeight, (int64_t)pindex->nTime));
+            if((int)vecPaid.size() > LAST_PAID_HISTORY_SIZE) {
+                vecPaid.erase(vecPaid.begin());
+            }
+        }
+    }
+
+    hashLastPaidBlock = pindex->GetBlockHash();
+}
+
+void CMasternodeMan::DisconnectLastPaidBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs);
+
+    if(!pindex->pprev || hashLastPaidBlock != pindex->GetBlockHash()) return;
+
+    // payees paid in this block and the payment before it (none if there is no such payment left)
+    std::map<CKeyID, std::pair<int, int64_t> > mapPreviousPaid;
+    BOOST_FOREACH(const CTxOut& txout, block.vtx[0].vout) {
+        CTxDestination dest;
+        if(!ExtractDestination(txout.scriptPubKey, dest)) continue;
+        const CKeyID* pkeyID = boost::get<CKeyID>(&dest);
+        if(!pkeyID) continue;
+        std::map<CKeyID, std::vector<std::pair<int, int64_t> > >::iterator it = mapPayeeLastPaid.find(*pkeyID);
+        if(it == mapPayeeLastPaid.end() || it->second.back().first != pindex->nHeight) continue;
+        it->second.pop_back();
+        if(it->second.empty()) {
+            mapPayeeLastPaid.erase(it);
+            mapPreviousPaid[*pkeyID] = std::make_pair(0, (int64_t)0);
+        } else {
+            mapPreviousPaid[*pkeyID] = it->second.back();
+        }
+    }
+
+    // masternodes must not keep a last paid block above the new tip
+    if(!mapPreviousPaid.empty()) {
+        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+            if(mn.nBlockLastPaid < pindex->nHeight) continue;
+            std::map<CKeyID, std::pair<int, int64_t> >::iterator it = mapPreviousPaid.find(mn.pubKeyCollateralAddress.GetID());
+            if(it != mapPreviousPaid.end()) {
+                SetLastPaid(mn, it->second.first, it->second.second);
+            }
+        }
+    }
+
+    hashLastPaidBlock = pindex->pprev->GetBlockHash();
 }
 
 void CMasternodeMan::CheckAndRebuildMasternodeIndex()
@@ -1633,6 +2232,7 @@ void CMasternodeMan::SetMasternodeLastPing(const CTxIn& vin, const CMasternodePi
     }
     pMN->lastPing = mnp;
     mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+    MasternodeListEntryChanged(vin.prevout);
 
     CMasternodeBroadcast mnb(*pMN);
     uint256 hash = mnb.GetHash();
@@ -1644,10 +2244,13 @@ void CMasternodeMan::SetMasternodeLastPing(const CTxIn& vin, const CMasternodePi
 void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
 {
     pCurrentBlockIndex = pindex;
+    nCachedBlockHeight = pindex->nHeight;
     LogPrint("masternode", "CMasternodeMan::UpdatedBlockTip -- pCurrentBlockIndex->nHeight=%d\n", pCurrentBlockIndex->nHeight);
 
     CheckSameAddr();
 
+    ResolveCollateralHeights();
+
     if(fMasterNode) {
         // normal wallet does not need to update this every block, doing update on rpc call should be enough
         UpdateLastPaid();
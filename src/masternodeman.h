@@ -8,12 +8,23 @@
 #include "masternode.h"
 #include "sync.h"
 
+#include <atomic>
+#include <deque>
+
+#include <boost/shared_ptr.hpp>
+
 using namespace std;
 
 class CMasternodeMan;
+class CScheduler;
 
 extern CMasternodeMan mnodeman;
 
+/** Run an instance of the masternode signature checking thread */
+void ThreadMasternodeSignatureCheck();
+/** Verify a batch of signatures on the masternode signature checking threads, see CMasternodeSignatureCheck */
+void VerifyMasternodeSignatures(std::vector<CMasternodeSignatureCheck>& vChecks);
+
 /**
  * Provides a forward and reverse index between MN vin's and integers.
  *
@@ -78,6 +89,82 @@ private:
 
 };
 
+/**
+ * Identifies a version of the masternode list of a node.
+ *
+ * Every masternode added, updated or pinged bumps the version, so a peer which
+ * remembers the digest of its last sync with us can ask for the entries changed
+ * since then instead of the whole list. Removed entries are not tracked: peers
+ * remove masternodes with spent collateral on their own.
+ */
+class CMasternodeListDigest
+{
+public:
+    uint256 hashListId;
+    int64_t nVersion;
+
+    CMasternodeListDigest()
+        : hashListId(),
+          nVersion(0)
+    {}
+
+    CMasternodeListDigest(const uint256& hashListIdIn, int64_t nVersionIn)
+        : hashListId(hashListIdIn),
+          nVersion(nVersionIn)
+    {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersionIn)
+    {
+        READWRITE(hashListId);
+        READWRITE(nVersion);
+    }
+};
+
+/**
+ * An immutable copy of the masternode list for readers like RPC, the GUI and governance.
+ *
+ * CMasternodeMan publishes a new snapshot from its maintenance tick when the list
+ * changed, readers share the current one without taking CMasternodeMan::cs.
+ */
+class CMasternodeListSnapshot
+{
+public:
+    const std::vector<CMasternode> vMasternodes;
+    /// Time the snapshot was taken
+    const int64_t nTime;
+
+    CMasternodeListSnapshot(const std::vector<CMasternode>& vMasternodesIn, int64_t nTimeIn) :
+        vMasternodes(vMasternodesIn),
+        nTime(nTimeIn)
+        {}
+};
+
+typedef boost::shared_ptr<const CMasternodeListSnapshot> CMasternodeListSnapshot_sptr;
+
+/** Counters of the masternode proof-of-service verification worker */
+class CMasternodeVerificationStats
+{
+public:
+    int64_t nRequestsSent;
+    int64_t nRequestsTimedOut;
+    int64_t nRepliesVerified;
+    int64_t nBroadcastsVerified;
+    int64_t nMessagesDropped;
+
+    CMasternodeVerificationStats() :
+        nRequestsSent(0),
+        nRequestsTimedOut(0),
+        nRepliesVerified(0),
+        nBroadcastsVerified(0),
+        nMessagesDropped(0)
+        {}
+
+    std::string ToString() const;
+};
+
 class CMasternodeMan
 {
 public:
@@ -96,37 +183,105 @@ private:
     static const std::string SERIALIZATION_VERSION_STRING;
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
+    /// Digests of peer lists are kept this long, the peer has moved on to another list by then
+    static const int LIST_DIGEST_EXPIRE_SECONDS = 24 * 60 * 60;
 
-    static const int LAST_PAID_SCAN_BLOCKS      = 100;
+    /// Broadcasts received during list sync are verified in batches of this size
+    static const size_t MNB_VERIFY_BATCH_SIZE   = 256;
+
+    /// Number of recent payments kept per payee, so that disconnecting a block can restore the previous one
+    static const int LAST_PAID_HISTORY_SIZE     = 4;
 
     static const int MIN_POSE_PROTO_VERSION     = 70203;
     static const int MAX_POSE_CONNECTIONS       = 10;
     static const int MAX_POSE_RANK              = 10;
     static const int MAX_POSE_BLOCKS            = 10;
 
+    /// Proof-of-service verification work runs on the scheduler every POSE_VERIFY_TICK_SECONDS,
+    /// a masternode sends new verification requests every POSE_VERIFY_STEP_SECONDS
+    static const int POSE_VERIFY_TICK_SECONDS       = 1;
+    static const int POSE_VERIFY_STEP_SECONDS       = 5 * 60;
+    /// Verification requests still unanswered after this many seconds no longer count as in flight
+    static const int POSE_VERIFY_TIMEOUT_SECONDS    = 60;
+    /// Limit on verification requests waiting for a reply at any time
+    static const int MAX_POSE_REQUESTS_IN_FLIGHT    = 20;
+    /// Verification replies and broadcasts are queued up to MAX_POSE_PENDING_MESSAGES
+    /// and processed at most MAX_POSE_VERIFY_BATCH_SIZE per tick
+    static const size_t MAX_POSE_PENDING_MESSAGES   = 1000;
+    static const size_t MAX_POSE_VERIFY_BATCH_SIZE  = 64;
+
     static const int MNB_RECOVERY_QUORUM_TOTAL      = 10;
     static const int MNB_RECOVERY_QUORUM_REQUIRED   = 6;
     static const int MNB_RECOVERY_MAX_ASK_ENTRIES   = 10;
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    /// Republish the list snapshot at least this often, even if no change was flagged
+    static const int LIST_SNAPSHOT_MAX_AGE_SECONDS  = 60;
+
+    /// Number of block hashes to keep masternode score rankings for
+    static const int MAX_RANKING_CACHE_SIZE         = 16;
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
+    // Height of the active chain, published on every block connected or disconnected
+    // so that collateral age can be computed without cs_main
+    std::atomic<int> nCachedBlockHeight;
 
     // map to hold all MNs
     std::vector<CMasternode> vMasternodes;
+    // positions in vMasternodes of the first MN with a given collateral outpoint,
+    // masternode key or payee script, rebuilt whenever vMasternodes is reordered
+    std::map<COutPoint, size_t> mapMasternodeByOutpoint;
+    std::map<CPubKey, size_t> mapMasternodeByPubKey;
+    std::map<CScript, size_t> mapMasternodeByPayee;
+    // all masternodes ordered by last paid block (then collateral outpoint), i.e. in payment queue order
+    std::set<std::pair<int, COutPoint> > setPaymentQueue;
+    // positions in vMasternodes ordered from best to worst score, by block hash,
+    // cleared whenever vMasternodes changes
+    std::map<uint256, std::vector<size_t> > mapRankingCache;
+    std::list<uint256> listRankingCacheOrder;
+    // recent masternode payments (block height and time, oldest first) by payee,
+    // maintained from the coinbase of connected and disconnected blocks
+    std::map<CKeyID, std::vector<std::pair<int, int64_t> > > mapPayeeLastPaid;
+    // last block applied to mapPayeeLastPaid
+    uint256 hashLastPaidBlock;
+    // random id of our masternode list, renewed whenever the list is cleared
+    uint256 hashListId;
+    // current version of our masternode list and the version each entry last changed at
+    int64_t nListVersion;
+    std::map<COutPoint, int64_t> mapListEntryVersion;
+    // digests of the masternode lists of peers we synced with and when to forget them
+    std::map<CNetAddr, std::pair<CMasternodeListDigest, int64_t> > mapKnownListDigests;
+    // held for a whole flush of the pending broadcasts, so that batches flushed from the
+    // message handler and the DarkSend pool thread are processed in the order they arrived;
+    // taken before cs and cs_main
+    CCriticalSection cs_pendingmnb;
+    // broadcasts received during list sync (with the referenced peers they came from),
+    // their signatures are verified in parallel before they are processed
+    std::vector<std::pair<CNode*, CMasternodeBroadcast> > vecPendingMnb;
     // who's asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
     // who we asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mWeAskedForMasternodeList;
     // which Masternodes we've asked for
     std::map<COutPoint, std::map<CNetAddr, int64_t> > mWeAskedForMasternodeListEntry;
+
+    // critical section to protect the proof-of-service verification state below,
+    // it may be taken while holding cs_main or cs but never the other way around
+    mutable CCriticalSection cs_verify;
     // who we asked for the masternode verification
     std::map<CNetAddr, CMasternodeVerification> mWeAskedForVerification;
+    // verification requests waiting for a reply and the time they were sent
+    std::map<CNetAddr, int64_t> mapVerifyRequestsInFlight;
+    // verification replies and broadcasts (with the referenced peers they came from)
+    // waiting for the verification worker
+    std::deque<std::pair<CNode*, CMasternodeVerification> > dequePendingMnv;
+    int64_t nLastFullVerificationTime;
+    CMasternodeVerificationStats statsVerify;
 
     // these maps are used for masternode recovery from MASTERNODE_NEW_START_REQUIRED state
     std::map<uint256, std::pair< int64_t, std::set<CNetAddr> > > mMnbRecoveryRequests;
@@ -152,8 +307,34 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // current snapshot of vMasternodes, only accessed through boost::atomic_load/atomic_store
+    CMasternodeListSnapshot_sptr pListSnapshot;
+    // set when vMasternodes changed since pListSnapshot was published
+    bool fListSnapshotDirty;
+
     friend class CMasternodeSync;
 
+    /// Add the entry at vMasternodes[nPos] to the lookup maps unless an earlier one has the same key
+    void AddToLookupIndexes(size_t nPos);
+    void RebuildLookupIndexes();
+
+    /// Return the (cached) ranking of all masternodes against blockHash, regardless of their state
+    const std::vector<size_t>& GetRanking(const uint256& blockHash);
+    void ClearRankingCache();
+
+    /// Publish a new list snapshot if the list changed or the current one got too old
+    void PublishListSnapshot();
+
+    /// Check a broadcast received from pfrom and add or update the masternode
+    void ProcessMasternodeBroadcast(CNode* pfrom, CMasternodeBroadcast& mnb);
+
+    /// Record the masternode payment in the coinbase of a block connected to the tip
+    void ConnectLastPaidBlock(const CBlock& block, const CBlockIndex* pindex);
+    /// Forget the masternode payment in the coinbase of a block disconnected from the tip
+    void DisconnectLastPaidBlock(const CBlock& block, const CBlockIndex* pindex);
+    /// Set the last paid block and time of mn, keeping setPaymentQueue in order
+    void SetLastPaid(CMasternode& mn, int nBlockLastPaidIn, int64_t nTimeLastPaidIn);
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> > mapSeenMasternodeBroadcast;
@@ -191,9 +372,18 @@ public:
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
         READWRITE(indexMasternodes);
+        READWRITE(mapPayeeLastPaid);
+        READWRITE(hashLastPaidBlock);
+        READWRITE(hashListId);
+        READWRITE(nListVersion);
+        READWRITE(mapListEntryVersion);
+        READWRITE(mapKnownListDigests);
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
+        if(ser_action.ForRead()) {
+            RebuildLookupIndexes();
+        }
     }
 
     CMasternodeMan();
@@ -280,6 +470,9 @@ public:
 
     bool Has(const CTxIn& vin);
 
+    /// Must be called after the masternode key of a listed entry has changed
+    void MasternodePubKeyChanged();
+
     masternode_info_t GetMasternodeInfo(const CTxIn& vin);
 
     masternode_info_t GetMasternodeInfo(const CPubKey& pubKeyMasternode);
@@ -292,7 +485,8 @@ public:
     /// Find a random entry
     CMasternode* FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion = -1);
 
-    std::vector<CMasternode> GetFullMasternodeVector() { return vMasternodes; }
+    /// Return the current snapshot of the masternode list, without locking cs unless there is none yet
+    CMasternodeListSnapshot_sptr GetListSnapshot();
 
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
     int GetMasternodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
@@ -302,10 +496,19 @@ public:
     std::pair<CService, std::set<uint256> > PopScheduledMnbRequestConnection();
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    /// Verify the signatures of pending broadcasts in parallel and process them
+    void ProcessPendingBroadcasts();
+
+    /// Run proof-of-service verification work on the scheduler
+    void ScheduleVerification(CScheduler& scheduler);
+    /// Process queued verification messages, expire old requests and send new ones when it's time
+    void DoVerificationWork();
+    void ProcessPendingVerifications();
+    void CheckVerificationRequests();
 
     void DoFullVerificationStep();
     void CheckSameAddr();
-    bool SendVerifyRequest(const CAddress& addr, const std::vector<CMasternode*>& vSortedByAddr);
+    bool SendVerifyRequest(const CAddress& addr, int nBlockHeight);
     void SendVerifyReply(CNode* pnode, CMasternodeVerification& mnv);
     void ProcessVerifyReply(CNode* pnode, CMasternodeVerification& mnv);
     void ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerification& mnv);
@@ -317,11 +520,22 @@ public:
 
     /// Update masternode list and maps using provided CMasternodeBroadcast
     void UpdateMasternodeList(CMasternodeBroadcast mnb);
+    /// Bump the version of our masternode list for an entry which was added, updated or pinged
+    void MasternodeListEntryChanged(const COutPoint& outpoint);
     /// Perform complete check and only then update list and maps
     bool CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
 
+    /// Apply the last paid index to all masternodes, catching up with blocks it missed
     void UpdateLastPaid();
+    /// Update last paid and collateral heights for a block connected to the tip
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex);
+    /// Undo BlockConnected for a block disconnected from the tip
+    void BlockDisconnected(const CBlock& block, const CBlockIndex* pindex);
+    /// Look up the collateral height of every masternode which doesn't have one yet
+    void ResolveCollateralHeights();
+    /// Height of the active chain as of the last block connected or disconnected
+    int GetCachedBlockHeight() const { return nCachedBlockHeight; }
 
     void CheckAndRebuildMasternodeIndex();
 
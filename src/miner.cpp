@@ -74,6 +74,308 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
     return nNewTime - nOldTime;
 }
 
+/** A cached selection older than this (in seconds) is always rebuilt from scratch */
+static const int64_t MAX_TEMPLATE_CACHE_AGE = 60;
+
+/**
+ * Transactions selected for a block on top of pindexPrev, excluding the
+ * coinbase. Transactions accepted to the mempool after the selection are
+ * queued in vAccepted, so that the next CreateNewBlock only has to append
+ * those instead of rescanning the whole pool. Any other change to the pool
+ * (a selected transaction leaving it, prioritisation, a new tip, a direct
+ * addUnchecked) shows up as a mismatch of nTransactionsUpdated and forces a
+ * full rebuild. Guarded by mempool.cs.
+ */
+class CBlockTemplateCache
+{
+public:
+    bool fValid;
+    const CBlockIndex* pindexPrev;
+    int nHeight;
+    int64_t nLockTimeCutoff;
+    int64_t nTimeBuilt;
+    unsigned int nTransactionsUpdated;
+    unsigned int nBlockMaxSize;
+    unsigned int nBlockPrioritySize;
+    unsigned int nBlockMinSize;
+
+    std::vector<CTransaction> vtx;
+    std::vector<CAmount> vTxFees;
+    std::vector<int64_t> vTxSigOps;
+    std::set<uint256> setInBlock;
+    uint64_t nBlockSize;
+    unsigned int nBlockSigOps;
+    CAmount nFees;
+    //! Lowest fee rate selected by score; better paying newcomers that do not fit need a rebuild
+    CFeeRate minFeeRate;
+
+    std::vector<uint256> vAccepted;
+
+    CBlockTemplateCache() { SetNull(); }
+
+    void SetNull()
+    {
+        fValid = false;
+        pindexPrev = NULL;
+        nHeight = 0;
+        nLockTimeCutoff = 0;
+        nTimeBuilt = 0;
+        nTransactionsUpdated = 0;
+        nBlockMaxSize = nBlockPrioritySize = nBlockMinSize = 0;
+        vtx.clear();
+        vTxFees.clear();
+        vTxSigOps.clear();
+        setInBlock.clear();
+        nBlockSize = 1000;
+        nBlockSigOps = 100;
+        nFees = 0;
+        minFeeRate = CFeeRate(MAX_MONEY);
+        vAccepted.clear();
+    }
+
+    void AddTx(CTxMemPool::txiter iter)
+    {
+        const CTransaction& tx = iter->GetTx();
+        vtx.push_back(tx);
+        vTxFees.push_back(iter->GetFee());
+        vTxSigOps.push_back(iter->GetSigOpCount());
+        setInBlock.insert(tx.GetHash());
+        nBlockSize += iter->GetTxSize();
+        nBlockSigOps += iter->GetSigOpCount();
+        nFees += iter->GetFee();
+    }
+};
+
+static CBlockTemplateCache templateCache;
+
+static void TemplateCacheEntryAccepted(const CTransaction& tx)
+{
+    AssertLockHeld(mempool.cs);
+    if (!templateCache.fValid)
+        return;
+    // The pool has already counted this addition
+    if (mempool.GetTransactionsUpdated() != templateCache.nTransactionsUpdated + 1) {
+        templateCache.SetNull();
+        return;
+    }
+    templateCache.nTransactionsUpdated++;
+    templateCache.vAccepted.push_back(tx.GetHash());
+}
+
+static void TemplateCacheEntryRemoved(const CTransaction& tx)
+{
+    AssertLockHeld(mempool.cs);
+    if (!templateCache.fValid)
+        return;
+    if (templateCache.setInBlock.count(tx.GetHash())) {
+        templateCache.SetNull();
+        return;
+    }
+    templateCache.nTransactionsUpdated++;
+}
+
+/** Select transactions from the whole mempool into the (reset) template cache */
+static void SelectTransactions(CBlockTemplateCache& cache, int nHeight, int64_t nLockTimeCutoff)
+{
+    // Collect memory pool transactions into the block
+    CTxMemPool::setEntries inBlock;
+    CTxMemPool::setEntries waitSet;
+
+    // This vector will be sorted into a priority queue:
+    vector<TxCoinAgePriority> vecPriority;
+    TxCoinAgePriorityCompare pricomparer;
+    std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
+    typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
+    double actualPriority = -1;
+
+    std::priority_queue<CTxMemPool::txiter, std::vector<CTxMemPool::txiter>, ScoreCompare> clearedTxs;
+    bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
+    int lastFewTxs = 0;
+
+    bool fPriorityBlock = cache.nBlockPrioritySize > 0;
+    if (fPriorityBlock) {
+        vecPriority.reserve(mempool.mapTx.size());
+        for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
+             mi != mempool.mapTx.end(); ++mi)
+        {
+            double dPriority = mi->GetPriority(nHeight);
+            CAmount dummy;
+            mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
+            vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
+        }
+        std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+    }
+
+    CTxMemPool::indexed_transaction_set::nth_index<3>::type::iterator mi = mempool.mapTx.get<3>().begin();
+    CTxMemPool::txiter iter;
+
+    while (mi != mempool.mapTx.get<3>().end() || !clearedTxs.empty())
+    {
+        bool priorityTx = false;
+        if (fPriorityBlock && !vecPriority.empty()) { // add a tx from priority queue to fill the blockprioritysize
+            priorityTx = true;
+            iter = vecPriority.front().second;
+            actualPriority = vecPriority.front().first;
+            std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+            vecPriority.pop_back();
+        }
+        else if (clearedTxs.empty()) { // add tx with next highest score
+            iter = mempool.mapTx.project<0>(mi);
+            mi++;
+        }
+        else {  // try to add a previously postponed child tx
+            iter = clearedTxs.top();
+            clearedTxs.pop();
+        }
+
+        if (inBlock.count(iter))
+            continue; // could have been added to the priorityBlock
+
+        const CTransaction& tx = iter->GetTx();
+
+        bool fOrphan = false;
+        BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter))
+        {
+            if (!inBlock.count(parent)) {
+                fOrphan = true;
+                break;
+            }
+        }
+        if (fOrphan) {
+            if (priorityTx)
+                waitPriMap.insert(std::make_pair(iter,actualPriority));
+            else
+                waitSet.insert(iter);
+            continue;
+        }
+
+        unsigned int nTxSize = iter->GetTxSize();
+        if (fPriorityBlock &&
+            (cache.nBlockSize + nTxSize >= cache.nBlockPrioritySize || !AllowFree(actualPriority))) {
+            fPriorityBlock = false;
+            waitPriMap.clear();
+        }
+        if (!priorityTx &&
+            (iter->GetModifiedFee() < ::minRelayTxFee.GetFee(nTxSize) && cache.nBlockSize >= cache.nBlockMinSize)) {
+            break;
+        }
+        if (cache.nBlockSize + nTxSize >= cache.nBlockMaxSize) {
+            if (cache.nBlockSize >  cache.nBlockMaxSize - 100 || lastFewTxs > 50) {
+                break;
+            }
+            // Once we're within 1000 bytes of a full block, only look at 50 more txs
+            // to try to fill the remaining space.
+            if (cache.nBlockSize > cache.nBlockMaxSize - 1000) {
+                lastFewTxs++;
+            }
+            continue;
+        }
+
+        if (!IsFinalTx(tx, nHeight, nLockTimeCutoff))
+            continue;
+
+        unsigned int nTxSigOps = iter->GetSigOpCount();
+        if (cache.nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS) {
+            if (cache.nBlockSigOps > MAX_BLOCK_SIGOPS - 2) {
+                break;
+            }
+            continue;
+        }
+
+        // Added
+        cache.AddTx(iter);
+        if (!priorityTx)
+            cache.minFeeRate = std::min(cache.minFeeRate, CFeeRate(iter->GetModifiedFee(), nTxSize));
+
+        if (fPrintPriority)
+        {
+            double dPriority = iter->GetPriority(nHeight);
+            CAmount dummy;
+            mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
+            LogPrintf("priority %.1f fee %s txid %s\n",
+                      dPriority , CFeeRate(iter->GetModifiedFee(), nTxSize).ToString(), tx.GetHash().ToString());
+        }
+
+        inBlock.insert(iter);
+
+        // Add transactions that depend on this one to the priority queue
+        BOOST_FOREACH(CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter))
+        {
+            if (fPriorityBlock) {
+                waitPriIter wpiter = waitPriMap.find(child);
+                if (wpiter != waitPriMap.end()) {
+                    vecPriority.push_back(TxCoinAgePriority(wpiter->second,child));
+                    std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+                    waitPriMap.erase(wpiter);
+                }
+            }
+            else {
+                if (waitSet.count(child)) {
+                    clearedTxs.push(child);
+                    waitSet.erase(child);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Append the transactions accepted since the last selection. Returns false
+ * if one of them could have changed the selection itself, in which case the
+ * caller has to rebuild from scratch.
+ */
+static bool AppendAcceptedTransactions(CBlockTemplateCache& cache)
+{
+    BOOST_FOREACH(const uint256& hash, cache.vAccepted)
+    {
+        CTxMemPool::txiter iter = mempool.mapTx.find(hash);
+        if (iter == mempool.mapTx.end() || cache.setInBlock.count(hash))
+            continue;
+
+        // Parents are accepted before their children, so a parent that is
+        // not in the block was left out on purpose and so is the child
+        bool fOrphan = false;
+        BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter))
+        {
+            if (!cache.setInBlock.count(parent->GetTx().GetHash())) {
+                fOrphan = true;
+                break;
+            }
+        }
+        if (fOrphan)
+            continue;
+
+        unsigned int nTxSize = iter->GetTxSize();
+        if (iter->GetModifiedFee() < ::minRelayTxFee.GetFee(nTxSize) && cache.nBlockSize >= cache.nBlockMinSize) {
+            // Only the priority area takes such transactions
+            if (cache.nBlockPrioritySize > 0) {
+                double dPriority = iter->GetPriority(cache.nHeight);
+                CAmount dummy;
+                mempool.ApplyDeltas(hash, dPriority, dummy);
+                if (AllowFree(dPriority))
+                    return false;
+            }
+            continue;
+        }
+
+        if (cache.nBlockSize + nTxSize >= cache.nBlockMaxSize ||
+            cache.nBlockSigOps + iter->GetSigOpCount() >= MAX_BLOCK_SIGOPS) {
+            // A full block would have to drop something cheaper to take it
+            if (CFeeRate(iter->GetModifiedFee(), nTxSize) > cache.minFeeRate)
+                return false;
+            continue;
+        }
+
+        if (!IsFinalTx(iter->GetTx(), cache.nHeight, cache.nLockTimeCutoff))
+            continue;
+
+        cache.AddTx(iter);
+        cache.minFeeRate = std::min(cache.minFeeRate, CFeeRate(iter->GetModifiedFee(), nTxSize));
+    }
+    cache.vAccepted.clear();
+    return true;
+}
+
 CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn)
 {
     // Create new block
@@ -109,25 +411,6 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
     unsigned int nBlockMinSize = GetArg("-blockminsize", DEFAULT_BLOCK_MIN_SIZE);
     nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
 
-    // Collect memory pool transactions into the block
-    CTxMemPool::setEntries inBlock;
-    CTxMemPool::setEntries waitSet;
-
-    // This vector will be sorted into a priority queue:
-    vector<TxCoinAgePriority> vecPriority;
-    TxCoinAgePriorityCompare pricomparer;
-    std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
-    typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
-    double actualPriority = -1;
-
-    std::priority_queue<CTxMemPool::txiter, std::vector<CTxMemPool::txiter>, ScoreCompare> clearedTxs;
-    bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
-    uint64_t nBlockSize = 1000;
-    uint64_t nBlockTx = 0;
-    unsigned int nBlockSigOps = 100;
-    int lastFewTxs = 0;
-    CAmount nFees = 0;
-
     {
         LOCK2(cs_main, mempool.cs);
         CBlockIndex* pindexPrev = chainActive.Tip();
@@ -148,138 +431,47 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
                                 ? nMedianTimePast
                                 : pblock->GetBlockTime();
 
-
-        bool fPriorityBlock = nBlockPrioritySize > 0;
-        if (fPriorityBlock) {
-            vecPriority.reserve(mempool.mapTx.size());
-            for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
-                 mi != mempool.mapTx.end(); ++mi)
-            {
-                double dPriority = mi->GetPriority(nHeight);
-                CAmount dummy;
-                mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
-                vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
-            }
-            std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+        static bool fNotificationsConnected = false;
+        if (!fNotificationsConnected) {
+            mempool.NotifyEntryAccepted.connect(&TemplateCacheEntryAccepted);
+            mempool.NotifyEntryRemoved.connect(&TemplateCacheEntryRemoved);
+            fNotificationsConnected = true;
         }
 
-        CTxMemPool::indexed_transaction_set::nth_index<3>::type::iterator mi = mempool.mapTx.get<3>().begin();
-        CTxMemPool::txiter iter;
-
-        while (mi != mempool.mapTx.get<3>().end() || !clearedTxs.empty())
-        {
-            bool priorityTx = false;
-            if (fPriorityBlock && !vecPriority.empty()) { // add a tx from priority queue to fill the blockprioritysize
-                priorityTx = true;
-                iter = vecPriority.front().second;
-                actualPriority = vecPriority.front().first;
-                std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-                vecPriority.pop_back();
-            }
-            else if (clearedTxs.empty()) { // add tx with next highest score
-                iter = mempool.mapTx.project<0>(mi);
-                mi++;
-            }
-            else {  // try to add a previously postponed child tx
-                iter = clearedTxs.top();
-                clearedTxs.pop();
-            }
-
-            if (inBlock.count(iter))
-                continue; // could have been added to the priorityBlock
-
-            const CTransaction& tx = iter->GetTx();
-
-            bool fOrphan = false;
-            BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter))
-            {
-                if (!inBlock.count(parent)) {
-                    fOrphan = true;
-                    break;
-                }
-            }
-            if (fOrphan) {
-                if (priorityTx)
-                    waitPriMap.insert(std::make_pair(iter,actualPriority));
-                else
-                    waitSet.insert(iter);
-                continue;
-            }
-
-            unsigned int nTxSize = iter->GetTxSize();
-            if (fPriorityBlock &&
-                (nBlockSize + nTxSize >= nBlockPrioritySize || !AllowFree(actualPriority))) {
-                fPriorityBlock = false;
-                waitPriMap.clear();
-            }
-            if (!priorityTx &&
-                (iter->GetModifiedFee() < ::minRelayTxFee.GetFee(nTxSize) && nBlockSize >= nBlockMinSize)) {
-                break;
-            }
-            if (nBlockSize + nTxSize >= nBlockMaxSize) {
-                if (nBlockSize >  nBlockMaxSize - 100 || lastFewTxs > 50) {
-                    break;
-                }
-                // Once we're within 1000 bytes of a full block, only look at 50 more txs
-                // to try to fill the remaining space.
-                if (nBlockSize > nBlockMaxSize - 1000) {
-                    lastFewTxs++;
-                }
-                continue;
-            }
-
-            if (!IsFinalTx(tx, nHeight, nLockTimeCutoff))
-                continue;
-
-            unsigned int nTxSigOps = iter->GetSigOpCount();
-            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS) {
-                if (nBlockSigOps > MAX_BLOCK_SIGOPS - 2) {
-                    break;
-                }
-                continue;
-            }
-
-            CAmount nTxFees = iter->GetFee();
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOps.push_back(nTxSigOps);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nBlockSigOps += nTxSigOps;
-            nFees += nTxFees;
-
-            if (fPrintPriority)
-            {
-                double dPriority = iter->GetPriority(nHeight);
-                CAmount dummy;
-                mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                          dPriority , CFeeRate(iter->GetModifiedFee(), nTxSize).ToString(), tx.GetHash().ToString());
-            }
-
-            inBlock.insert(iter);
-
-            // Add transactions that depend on this one to the priority queue
-            BOOST_FOREACH(CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter))
-            {
-                if (fPriorityBlock) {
-                    waitPriIter wpiter = waitPriMap.find(child);
-                    if (wpiter != waitPriMap.end()) {
-                        vecPriority.push_back(TxCoinAgePriority(wpiter->second,child));
-                        std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-                        waitPriMap.erase(wpiter);
-                    }
-                }
-                else {
-                    if (waitSet.count(child)) {
-                        clearedTxs.push(child);
-                        waitSet.erase(child);
-                    }
-                }
-            }
+        // Reuse the previous selection if it was made for the same tip and
+        // policy and only transactions validated by AcceptToMemoryPool were
+        // added since. Those need no block level re-validation either.
+        bool fIncremental = templateCache.fValid &&
+                            templateCache.pindexPrev == pindexPrev &&
+                            templateCache.nHeight == nHeight &&
+                            templateCache.nLockTimeCutoff == nLockTimeCutoff &&
+                            templateCache.nBlockMaxSize == nBlockMaxSize &&
+                            templateCache.nBlockPrioritySize == nBlockPrioritySize &&
+                            templateCache.nBlockMinSize == nBlockMinSize &&
+                            templateCache.nTransactionsUpdated == mempool.GetTransactionsUpdated() &&
+                            GetTime() - templateCache.nTimeBuilt < MAX_TEMPLATE_CACHE_AGE &&
+                            AppendAcceptedTransactions(templateCache);
+        if (!fIncremental) {
+            templateCache.SetNull();
+            templateCache.pindexPrev = pindexPrev;
+            templateCache.nHeight = nHeight;
+            templateCache.nLockTimeCutoff = nLockTimeCutoff;
+            templateCache.nTimeBuilt = GetTime();
+            templateCache.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+            templateCache.nBlockMaxSize = nBlockMaxSize;
+            templateCache.nBlockPrioritySize = nBlockPrioritySize;
+            templateCache.nBlockMinSize = nBlockMinSize;
+            SelectTransactions(templateCache, nHeight, nLockTimeCutoff);
         }
 
+        pblock->vtx.insert(pblock->vtx.end(), templateCache.vtx.begin(), templateCache.vtx.end());
+        pblocktemplate->vTxFees.insert(pblocktemplate->vTxFees.end(), templateCache.vTxFees.begin(), templateCache.vTxFees.end());
+        pblocktemplate->vTxSigOps.insert(pblocktemplate->vTxSigOps.end(), templateCache.vTxSigOps.begin(), templateCache.vTxSigOps.end());
+        uint64_t nBlockSize = templateCache.nBlockSize;
+        uint64_t nBlockTx = templateCache.vtx.size();
+        unsigned int nBlockSigOps = templateCache.nBlockSigOps;
+        CAmount nFees = templateCache.nFees;
+
         // NOTE: unlike in bitcoin, we need to pass PREVIOUS block height here
         CAmount blockReward = nFees + GetBlockSubsidy(pindexPrev->nBits, pindexPrev->nHeight, Params().GetConsensus());
 
@@ -298,7 +490,8 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
 
         nLastBlockTx = nBlockTx;
         nLastBlockSize = nBlockSize;
-        LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
+        LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d%s\n", nBlockSize, nBlockTx, nFees, nBlockSigOps,
+                  fIncremental ? " (incremental)" : "");
 
         // Update block coinbase
         pblock->vtx[0] = txNew;
@@ -311,15 +504,25 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
         pblock->nNonce         = 0;
         pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(pblock->vtx[0]);
 
-        CValidationState state;
-        if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
-            throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+        if (!fIncremental) {
+            CValidationState state;
+            if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+                throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+            }
+            // Only a selection that passed the full check may be extended
+            templateCache.fValid = true;
         }
     }
 
     return pblocktemplate.release();
 }
 
+void ResetBlockTemplateCache()
+{
+    LOCK(mempool.cs);
+    templateCache.SetNull();
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -454,7 +657,7 @@ void static BitcoinMiner(const CChainParams& chainparams)
             IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
 
             LogPrintf("TerracoinMiner -- Running miner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
-                ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
+                pblock->GetSerializeSizeCached(SER_NETWORK, PROTOCOL_VERSION));
 
             //
             // Search
@@ -113,17 +113,38 @@ static void MerkleComputation(const std::vector<uint256>& leaves, uint256* proot
 
 std::vector<uint256> CBlock::GetMerkleBranch(int nIndex) const
 {
-    std::vector<uint256> leaves;
-    leaves.resize(vtx.size());
-    for (size_t s = 0; s < vtx.size(); s++) {
-        leaves[s] = vtx[s].GetHash();
-    }
-
     std::vector<uint256> ret;
-    MerkleComputation(leaves, NULL, NULL, nIndex, &ret);
+    MerkleComputation(GetTxHashes(), NULL, NULL, nIndex, &ret);
     return ret;
 }
 
+const std::vector<uint256>& CBlock::GetTxHashes() const
+{
+    bool fMatch = vTxHashesCached.size() == vtx.size();
+    for (size_t i = 0; fMatch && i < vtx.size(); i++)
+        fMatch = vTxHashesCached[i] == vtx[i].GetHash();
+
+    if (!fMatch) {
+        vTxHashesCached.resize(vtx.size());
+        for (size_t i = 0; i < vtx.size(); i++)
+            vTxHashesCached[i] = vtx[i].GetHash();
+        fMerkleRootCached = false;
+        fMerkleMutatedCached = false;
+        nTxSizeCached = 0;
+    }
+    return vTxHashesCached;
+}
+
+unsigned int CBlock::GetSerializeSizeCached(int nType, int nVersion) const
+{
+    GetTxHashes();
+    if (nTxSizeCached == 0) {
+        for (size_t i = 0; i < vtx.size(); i++)
+            nTxSizeCached += ::GetSerializeSize(vtx[i], nType, nVersion);
+    }
+    return ::GetSerializeSize(*(const CBlockHeader*)this, nType, nVersion) + GetSizeOfCompactSize(vtx.size()) + nTxSizeCached;
+}
+
 uint256 CBlock::CheckMerkleBranch(uint256 hash, const std::vector<uint256>& vMerkleBranch, int nIndex)
 {
     if (nIndex == -1)
@@ -85,6 +85,14 @@ public:
     mutable std::vector<uint256> vMerkleTree;
     mutable bool fChecked;
 
+    // memory only: per-block values derived from vtx, reused for as long as
+    // the transaction hashes still match vTxHashesCached (see GetTxHashes)
+    mutable std::vector<uint256> vTxHashesCached;
+    mutable uint256 hashMerkleRootCached;
+    mutable bool fMerkleRootCached;
+    mutable bool fMerkleMutatedCached;
+    mutable unsigned int nTxSizeCached;
+
     CBlock()
     {
         SetNull();
@@ -112,6 +120,10 @@ public:
         voutSuperblock.clear();
         fChecked = false;
         vMerkleTree.clear();
+        vTxHashesCached.clear();
+        fMerkleRootCached = false;
+        fMerkleMutatedCached = false;
+        nTxSizeCached = 0;
     }
 
     CBlockHeader GetBlockHeader() const
@@ -133,6 +145,20 @@ public:
     uint256 BuildMerkleTree(bool* mutated = NULL) const;
 
     std::vector<uint256> GetMerkleBranch(int nIndex) const;
+
+    /**
+     * Return the hashes of vtx. If any transaction was added, removed or
+     * replaced since the last call, the cached merkle root and transaction
+     * sizes are dropped, so callers never see values for stale contents.
+     */
+    const std::vector<uint256>& GetTxHashes() const;
+
+    /**
+     * Equivalent to ::GetSerializeSize(*this, nType, nVersion), but only
+     * serializes the transactions when vtx changed since the last call.
+     * Transaction serialization does not depend on nType or nVersion.
+     */
+    unsigned int GetSerializeSizeCached(int nType, int nVersion) const;
     static uint256 CheckMerkleBranch(uint256 hash, const std::vector<uint256>& vMerkleBranch, int nIndex);
 
     std::string ToString() const;
@@ -60,10 +60,14 @@ const char *DSSTATUSUPDATE="dssu";
 const char *DSTX="dstx";
 const char *DSQUEUE="dsq";
 const char *DSEG="dseg";
+const char *DSEGDIFF="dsegdiff";
+const char *MNLISTDIGEST="mnlistdigest";
 const char *SYNCSTATUSCOUNT="ssc";
 const char *MNGOVERNANCESYNC="govsync";
 const char *MNGOVERNANCEOBJECT="govobj";
 const char *MNGOVERNANCEOBJECTVOTE="govobjvote";
+const char *MNGOVERNANCESYNCSUMMARY="govsyncsum";
+const char *MNGOVERNANCEVOTES="govvotes";
 const char *MNVERIFY="mnv";
 const char *SENDCMPCT ="sendcmpct";
 };
@@ -140,10 +144,14 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::DSTX,
     NetMsgType::DSQUEUE,
     NetMsgType::DSEG,
+    NetMsgType::DSEGDIFF,
+    NetMsgType::MNLISTDIGEST,
     NetMsgType::SYNCSTATUSCOUNT,
     NetMsgType::MNGOVERNANCESYNC,
     NetMsgType::MNGOVERNANCEOBJECT,
     NetMsgType::MNGOVERNANCEOBJECTVOTE,
+    NetMsgType::MNGOVERNANCESYNCSUMMARY,
+    NetMsgType::MNGOVERNANCEVOTES,
     NetMsgType::MNVERIFY,
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes+ARRAYLEN(allNetMessageTypes));
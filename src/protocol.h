@@ -239,10 +239,14 @@ extern const char *DSSTATUSUPDATE;
 extern const char *DSTX;
 extern const char *DSQUEUE;
 extern const char *DSEG;
+extern const char *DSEGDIFF;
+extern const char *MNLISTDIGEST;
 extern const char *SYNCSTATUSCOUNT;
 extern const char *MNGOVERNANCESYNC;
 extern const char *MNGOVERNANCEOBJECT;
 extern const char *MNGOVERNANCEOBJECTVOTE;
+extern const char *MNGOVERNANCESYNCSUMMARY;
+extern const char *MNGOVERNANCEVOTES;
 extern const char *MNVERIFY;
 extern const char *SENDCMPCT;
 };
@@ -7,6 +7,8 @@
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 
+#include <map>
+
 namespace
 {
 /* Global secp256k1_context object used for verification. */
@@ -164,14 +166,9 @@ static int ecdsa_signature_parse_der_lax(const secp256k1_context* ctx, secp256k1
     return 1;
 }
 
-bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const {
-    if (!IsValid())
-        return false;
-    secp256k1_pubkey pubkey;
+/** Verify a DER signature against an already parsed public key. */
+static bool VerifyParsed(const secp256k1_pubkey& pubkey, const uint256 &hash, const std::vector<unsigned char>& vchSig) {
     secp256k1_ecdsa_signature sig;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
-        return false;
-    }
     if (vchSig.size() == 0) {
         return false;
     }
@@ -184,6 +181,54 @@ bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchS
     return secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), &pubkey);
 }
 
+bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const {
+    if (!IsValid())
+        return false;
+    secp256k1_pubkey pubkey;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
+        return false;
+    }
+    return VerifyParsed(pubkey, hash, vchSig);
+}
+
+void CSignatureBatch::Add(const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) {
+    entries.push_back(Entry());
+    entries.back().hash = hash;
+    entries.back().vchSig = vchSig;
+    entries.back().pubkey = pubkey;
+}
+
+bool CSignatureBatch::Verify(std::vector<bool>& vValid) const {
+    // Parsed keys, or NULL for keys that failed to parse
+    std::map<CPubKey, const secp256k1_pubkey*> mapParsed;
+    std::vector<secp256k1_pubkey> vParsed;
+    vParsed.reserve(entries.size());
+    bool fAllValid = true;
+
+    vValid.assign(entries.size(), false);
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& entry = entries[i];
+        if (!entry.pubkey.IsValid()) {
+            fAllValid = false;
+            continue;
+        }
+        std::map<CPubKey, const secp256k1_pubkey*>::iterator it = mapParsed.find(entry.pubkey);
+        if (it == mapParsed.end()) {
+            secp256k1_pubkey pubkey;
+            const secp256k1_pubkey* ppubkey = NULL;
+            if (secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &entry.pubkey[0], entry.pubkey.size())) {
+                // vParsed never grows beyond its reserved size, so this pointer stays valid
+                vParsed.push_back(pubkey);
+                ppubkey = &vParsed.back();
+            }
+            it = mapParsed.insert(std::make_pair(entry.pubkey, ppubkey)).first;
+        }
+        vValid[i] = it->second != NULL && VerifyParsed(*it->second, entry.hash, entry.vchSig);
+        fAllValid &= vValid[i];
+    }
+    return fAllValid;
+}
+
 bool CPubKey::RecoverCompact(const uint256 &hash, const std::vector<unsigned char>& vchSig) {
     if (vchSig.size() != 65)
         return false;
@@ -210,6 +210,33 @@ struct CExtPubKey {
     bool Derive(CExtPubKey& out, unsigned int nChild) const;
 };
 
+/**
+ * A set of ECDSA signature checks that are verified together.
+ * libsecp256k1 offers no batch verification for ECDSA, so every entry is
+ * still verified on its own, but each distinct public key is only parsed
+ * (and, for compressed keys, decompressed) once per batch.
+ */
+class CSignatureBatch
+{
+private:
+    struct Entry
+    {
+        uint256 hash;
+        std::vector<unsigned char> vchSig;
+        CPubKey pubkey;
+    };
+    std::vector<Entry> entries;
+
+public:
+    void Add(const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey);
+
+    size_t size() const { return entries.size(); }
+    void clear() { entries.clear(); }
+
+    //! Verify all entries; vValid[i] is set to the result for the i'th one. Returns whether all were valid.
+    bool Verify(std::vector<bool>& vValid) const;
+};
+
 /** Users of this module must hold an ECCVerifyHandle. The constructor and
  *  destructor of these are not allowed to run in parallel, though. */
 class ECCVerifyHandle
@@ -14,6 +14,7 @@
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpcserver.h"
+#include "script/sigcache.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
@@ -956,6 +957,12 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
     ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
 
+    SignatureCacheStats sigcacheStats;
+    GetSignatureCacheStats(sigcacheStats);
+    ret.push_back(Pair("sigcachesize", (int64_t) sigcacheStats.nElements));
+    ret.push_back(Pair("sigcachehits", (int64_t) sigcacheStats.nHits));
+    ret.push_back(Pair("sigcachemisses", (int64_t) sigcacheStats.nMisses));
+
     return ret;
 }
 
@@ -971,7 +978,10 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "  \"bytes\": xxxxx,              (numeric) Sum of all tx sizes\n"
             "  \"usage\": xxxxx,              (numeric) Total memory usage for the mempool\n"
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
-            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee for tx to be accepted\n"
+            "  \"mempoolminfee\": xxxxx,      (numeric) Minimum fee for tx to be accepted\n"
+            "  \"sigcachesize\": xxxxx,       (numeric) Number of entries the signature cache can hold\n"
+            "  \"sigcachehits\": xxxxx,       (numeric) Signature cache lookups that found a valid entry\n"
+            "  \"sigcachemisses\": xxxxx      (numeric) Signature cache lookups that had to verify the signature\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
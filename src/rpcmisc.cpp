@@ -569,6 +569,174 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/**
+ * Hands address index entries to visitor until nLimit entries were visited
+ * (0 = no limit). The key of the last visited entry is the cursor of the
+ * next page.
+ */
+class CAddressIndexPager
+{
+private:
+    size_t nLimit;
+    size_t nVisited;
+    boost::function<void (const CAddressIndexKey&, CAmount)> visitor;
+
+public:
+    CAddressIndexKey keyLast;
+    bool fMore;
+
+    CAddressIndexPager(size_t nLimitIn, const boost::function<void (const CAddressIndexKey&, CAmount)>& visitorIn) :
+        nLimit(nLimitIn), nVisited(0), visitor(visitorIn), fMore(false) {}
+
+    bool operator()(const CAddressIndexKey& key, CAmount nValue)
+    {
+        if (nLimit && nVisited == nLimit) {
+            fMore = true;
+            return false;
+        }
+        nVisited++;
+        keyLast = key;
+        visitor(key, nValue);
+        return true;
+    }
+};
+
+/** Whether the request asks for a single page of results ("limit" or "cursor") */
+bool isPagedAddressRequest(const UniValue& params)
+{
+    if (!params[0].isObject())
+        return false;
+    return find_value(params[0].get_obj(), "limit").isNum() || find_value(params[0].get_obj(), "cursor").isStr();
+}
+
+bool getAddressIndexCursor(const UniValue& params, CAddressIndexKey& key)
+{
+    if (!params[0].isObject())
+        return false;
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (!cursorValue.isStr())
+        return false;
+    if (!IsHex(cursorValue.get_str()))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor must be a hex string");
+    std::vector<unsigned char> vch = ParseHex(cursorValue.get_str());
+    CDataStream ss(vch, SER_DISK, CLIENT_VERSION);
+    try {
+        ss >> key;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    return true;
+}
+
+/**
+ * Stream the address index entries of all addresses, in the order given,
+ * into visitor. A paged request resumes after its "cursor" and stops after
+ * "limit" entries. Returns the cursor of the next page, or null once the
+ * scan is complete.
+ */
+UniValue scanAddressesIndex(const UniValue& params, const std::vector<std::pair<uint160, int> >& addresses,
+                            int start, int end, const boost::function<void (const CAddressIndexKey&, CAmount)>& visitor)
+{
+    size_t nLimit = 0;
+    if (params[0].isObject()) {
+        UniValue limitValue = find_value(params[0].get_obj(), "limit");
+        if (limitValue.isNum()) {
+            if (limitValue.get_int() <= 0)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be positive");
+            nLimit = limitValue.get_int();
+        }
+    }
+
+    CAddressIndexKey keyCursor;
+    bool fStarted = !getAddressIndexCursor(params, keyCursor);
+
+    CAddressIndexPager pager(nLimit, visitor);
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+        const CAddressIndexKey* pkeyAfter = NULL;
+        if (!fStarted) {
+            // Skip the addresses the previous pages already covered
+            if (it->first != keyCursor.hashBytes || it->second != (int)keyCursor.type)
+                continue;
+            fStarted = true;
+            pkeyAfter = &keyCursor;
+        }
+        if (!ScanAddressIndex(it->first, it->second, start, end, pkeyAfter, boost::ref(pager))) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (pager.fMore)
+            break;
+    }
+    if (!fStarted)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to any of the addresses");
+
+    if (!pager.fMore)
+        return NullUniValue;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << pager.keyLast;
+    return HexStr(ss.begin(), ss.end());
+}
+
+struct CAddressDeltaWriter
+{
+    UniValue& result;
+    CAddressDeltaWriter(UniValue& resultIn) : result(resultIn) {}
+
+    void operator()(const CAddressIndexKey& key, CAmount nValue)
+    {
+        std::string address;
+        if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+
+        UniValue delta(UniValue::VOBJ);
+        delta.push_back(Pair("satoshis", nValue));
+        delta.push_back(Pair("txid", key.txhash.GetHex()));
+        delta.push_back(Pair("index", (int)key.index));
+        delta.push_back(Pair("blockindex", (int)key.txindex));
+        delta.push_back(Pair("height", key.blockHeight));
+        delta.push_back(Pair("address", address));
+        result.push_back(delta);
+    }
+};
+
+/** Writes each txid once; entries of one transaction for one address are adjacent in the index */
+struct CAddressTxidWriter
+{
+    UniValue& result;
+    uint256 hashLast;
+    CAddressTxidWriter(UniValue& resultIn) : result(resultIn) {}
+
+    void operator()(const CAddressIndexKey& key, CAmount nValue)
+    {
+        if (key.txhash == hashLast)
+            return;
+        hashLast = key.txhash;
+        result.push_back(key.txhash.GetHex());
+    }
+};
+
+struct CAddressTxidCollector
+{
+    std::set<std::pair<int, std::string> >& txids;
+    CAddressTxidCollector(std::set<std::pair<int, std::string> >& txidsIn) : txids(txidsIn) {}
+
+    void operator()(const CAddressIndexKey& key, CAmount nValue)
+    {
+        txids.insert(std::make_pair(key.blockHeight, key.txhash.GetHex()));
+    }
+};
+
+struct CAddressIndexCounter
+{
+    int64_t& nCount;
+    CAddressIndexCounter(int64_t& nCountIn) : nCount(nCountIn) {}
+
+    void operator()(const CAddressIndexKey& key, CAmount nValue)
+    {
+        nCount++;
+    }
+};
+
 UniValue getaddressmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -722,6 +890,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many deltas and a cursor for the next page\n"
+            "  \"cursor\" (string, optional) Continue after the page that returned this cursor, with the same addresses\n"
+            "  \"countonly\" (boolean, optional, default=false) Only return the number of deltas\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -733,8 +904,18 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit or cursor):\n"
+            "{\n"
+            "  \"deltas\"  (array) The deltas of this page, as above\n"
+            "  \"next\"  (string) The cursor of the next page, or null if there are no more deltas\n"
+            "}\n"
+            "\nResult (with countonly):\n"
+            "{\n"
+            "  \"count\"  (number) The number of deltas\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -752,6 +933,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
         }
     }
+    if (!(start > 0 && end > 0)) {
+        start = end = 0;
+    }
 
     std::vector<std::pair<uint160, int> > addresses;
 
@@ -759,38 +943,24 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    UniValue countOnlyValue = find_value(params[0].get_obj(), "countonly");
+    if (countOnlyValue.isBool() && countOnlyValue.get_bool()) {
+        int64_t nCount = 0;
+        scanAddressesIndex(params, addresses, start, end, CAddressIndexCounter(nCount));
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("count", nCount));
+        return result;
     }
 
-    UniValue result(UniValue::VARR);
+    UniValue deltas(UniValue::VARR);
+    UniValue next = scanAddressesIndex(params, addresses, start, end, CAddressDeltaWriter(deltas));
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
-
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
-    }
+    if (!isPagedAddressRequest(params))
+        return deltas;
 
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("deltas", deltas));
+    result.push_back(Pair("next", next));
     return result;
 }
 
@@ -812,6 +982,7 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
             "{\n"
             "  \"balance\"  (string) The current balance in satoshis\n"
             "  \"received\"  (string) The total number of satoshis received (including change)\n"
+            "  \"txcount\"  (number) The number of transactions involving each address, summed over the addresses\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
@@ -824,27 +995,24 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
+    int64_t nTxCount = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalanceValue addressBalance;
+        if (!GetAddressBalance((*it).first, (*it).second, addressBalance)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += addressBalance.balance;
+        received += addressBalance.received;
+        nTxCount += addressBalance.nTxCount;
     }
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("balance", balance));
     result.push_back(Pair("received", received));
+    result.push_back(Pair("txcount", nTxCount));
 
     return result;
 
@@ -865,12 +1033,19 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Read at most this many index entries and return a cursor for the next page\n"
+            "  \"cursor\" (string, optional) Continue after the page that returned this cursor, with the same addresses\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (with limit or cursor):\n"
+            "{\n"
+            "  \"txids\"  (array) The txids of this page, in height order per address\n"
+            "  \"next\"  (string) The cursor of the next page, or null if there are no more entries\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -893,37 +1068,32 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!(start > 0 && end > 0)) {
+        start = end = 0;
+    }
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    if (isPagedAddressRequest(params)) {
+        UniValue txids(UniValue::VARR);
+        CAddressTxidWriter writer(txids);
+        CAddressIndexKey keyCursor;
+        if (getAddressIndexCursor(params, keyCursor))
+            writer.hashLast = keyCursor.txhash;
+        UniValue next = scanAddressesIndex(params, addresses, start, end, boost::ref(writer));
+
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("txids", txids));
+        result.push_back(Pair("next", next));
+        return result;
     }
 
-    std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
-        }
-    }
-
-    if (addresses.size() > 1) {
+    if (addresses.size() == 1) {
+        scanAddressesIndex(params, addresses, start, end, CAddressTxidWriter(result));
+    } else {
+        // Merge the histories by height
+        std::set<std::pair<int, std::string> > txids;
+        scanAddressesIndex(params, addresses, start, end, CAddressTxidCollector(txids));
         for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
             result.push_back(it->second);
         }
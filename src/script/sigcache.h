@@ -8,13 +8,18 @@
 
 #include "script/interpreter.h"
 
+#include <stdint.h>
 #include <vector>
 
-// DoS prevention: limit cache size to less than 40MB (over 500000
-// entries on 64-bit systems).
-static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 40;
+// DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
+// systems). Due to how we count cache size, actual memory usage is slightly
+// more (~32.25 MB)
+static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+// Maximum sig cache size allowed
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 class CPubKey;
+class CSignatureBatch;
 
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
@@ -27,4 +32,35 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+/**
+ * Signature checker that optimistically reports every signature that is not
+ * in the cache as valid, and records it in a CSignatureBatch instead. The
+ * script result is only meaningful once the batch has been verified; if any
+ * recorded signature turns out to be invalid the script has to be
+ * re-evaluated with a CachingTransactionSignatureChecker.
+ */
+class CollectingTransactionSignatureChecker : public TransactionSignatureChecker
+{
+private:
+    CSignatureBatch& batch;
+
+public:
+    CollectingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, CSignatureBatch& batchIn) : TransactionSignatureChecker(txToIn, nInIn), batch(batchIn) {}
+
+    bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
+};
+
+/** Signature cache usage counters, as reported by getmempoolinfo */
+struct SignatureCacheStats
+{
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint32_t nElements;
+    size_t nBytes;
+};
+
+/** Allocate the signature cache according to -maxsigcachesize. Must be called before any script checks. */
+void InitSignatureCache();
+void GetSignatureCacheStats(SignatureCacheStats& stats);
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
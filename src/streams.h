@@ -592,4 +592,50 @@ public:
     }
 };
 
+/** Read-only stream over a fixed range of memory that is owned elsewhere,
+ *  e.g. a memory-mapped file. Deserializes without copying the range first.
+ *
+ *  The caller must keep the memory alive for as long as the reader is used.
+ */
+class CMemoryReader
+{
+private:
+    // Disallow copies
+    CMemoryReader(const CMemoryReader&);
+    CMemoryReader& operator=(const CMemoryReader&);
+
+    int nType;
+    int nVersion;
+
+    const char* pbegin;
+    const char* pend;
+
+public:
+    CMemoryReader(const char* pbeginIn, size_t nSize, int nTypeIn, int nVersionIn) :
+        nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), pend(pbeginIn + nSize) {}
+
+    int GetType()                { return nType; }
+    int GetVersion()             { return nVersion; }
+
+    //! Number of bytes not read yet
+    size_t size() const          { return pend - pbegin; }
+
+    CMemoryReader& read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMemoryReader::read(): end of data");
+        memcpy(pch, pbegin, nSize);
+        pbegin += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    CMemoryReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
 #endif // BITCOIN_STREAMS_H
@@ -347,4 +347,47 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
     BOOST_CHECK(spent_a_duplicate_coinbase);
 }
 
+// Entries read through GetCoinsFromBase (as the block input prefetcher does)
+// must only enter the cache via AddFetchedCoins, and never clobber newer data.
+BOOST_AUTO_TEST_CASE(coins_prefetch_test)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest parent(&base);
+    uint256 txid1 = GetRandHash();
+    uint256 txid2 = GetRandHash();
+    {
+        CCoinsModifier coins1 = parent.ModifyCoins(txid1);
+        coins1->vout.resize(1);
+        coins1->vout[0].nValue = 1000;
+        coins1->nHeight = 1;
+    }
+    {
+        CCoinsModifier coins2 = parent.ModifyCoins(txid2);
+        coins2->vout.resize(1);
+        coins2->vout[0].nValue = 2000;
+        coins2->nHeight = 2;
+    }
+    BOOST_CHECK(parent.Flush());
+
+    CCoinsViewCacheTest cache(&parent);
+    CCoins fetched;
+    BOOST_CHECK(cache.GetCoinsFromBase(txid1, fetched));
+    BOOST_CHECK_EQUAL(fetched.vout[0].nValue, 1000);
+    BOOST_CHECK(!cache.HaveCoinsInCache(txid1));
+    BOOST_CHECK(!cache.GetCoinsFromBase(GetRandHash(), fetched));
+
+    BOOST_CHECK(cache.GetCoinsFromBase(txid1, fetched));
+    cache.AddFetchedCoins(txid1, fetched);
+    BOOST_CHECK(cache.HaveCoinsInCache(txid1));
+    BOOST_CHECK_EQUAL(cache.AccessCoins(txid1)->vout[0].nValue, 1000);
+    cache.SelfTest();
+
+    // A modified entry must win over a stale prefetch result
+    BOOST_CHECK(cache.GetCoinsFromBase(txid2, fetched));
+    cache.ModifyCoins(txid2)->vout[0].nValue = 3000;
+    cache.AddFetchedCoins(txid2, fetched);
+    BOOST_CHECK_EQUAL(cache.AccessCoins(txid2)->vout[0].nValue, 3000);
+    cache.SelfTest();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,100 @@
+// Copyright (c) 2016 Jeremy Rubin
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+
+#include "random.h"
+#include "test/test_terracoin.h"
+#include "uint256.h"
+
+#include <cstring>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+/** Reads the eight cuckoo hashes straight out of an already random key */
+class TestHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+typedef CuckooCache::cache<uint256, TestHasher> TestCache;
+
+/** Fraction of the first n inserted hashes that are still in the cache */
+double HitRate(const TestCache& set, const std::vector<uint256>& hashes, size_t n)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i)
+        count += set.contains(hashes[i], false);
+    return double(count) / double(n);
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(cuckoocache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(cuckoocache_empty)
+{
+    TestCache set;
+    set.setup(1 << 10);
+    for (int i = 0; i < 100; ++i)
+        BOOST_CHECK(!set.contains(GetRandHash(), false));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_hit_rate)
+{
+    // Inserting half as many entries as there are slots must keep nearly all of them
+    TestCache set;
+    uint32_t nElements = set.setup_bytes(1 << 16);
+    BOOST_CHECK_EQUAL(nElements, (1 << 16) / sizeof(uint256));
+
+    std::vector<uint256> hashes;
+    for (uint32_t i = 0; i < nElements / 2; ++i)
+        hashes.push_back(GetRandHash());
+    for (const uint256& hash : hashes)
+        set.insert(hash);
+    BOOST_CHECK(HitRate(set, hashes, hashes.size()) > 0.95);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_erase)
+{
+    TestCache set;
+    uint32_t nElements = set.setup(1 << 12);
+
+    // Insert a quarter of the table, then erase half of those entries
+    std::vector<uint256> hashes;
+    for (uint32_t i = 0; i < nElements / 4; ++i)
+        hashes.push_back(GetRandHash());
+    for (const uint256& hash : hashes)
+        set.insert(hash);
+    for (uint32_t i = 0; i < nElements / 8; ++i)
+        BOOST_CHECK(set.contains(hashes[i], true));
+
+    // Erasure is lazy: erased entries are still found until their slot is reused
+    BOOST_CHECK(HitRate(set, hashes, hashes.size()) > 0.95);
+
+    // New entries may take the erased slots, but must not displace the
+    // entries that were kept
+    std::vector<uint256> hashesNew;
+    for (uint32_t i = 0; i < nElements / 8; ++i)
+        hashesNew.push_back(GetRandHash());
+    for (const uint256& hash : hashesNew)
+        set.insert(hash);
+    size_t nKept = 0;
+    for (uint32_t i = nElements / 8; i < hashes.size(); ++i)
+        nKept += set.contains(hashes[i], false);
+    BOOST_CHECK(double(nKept) / (nElements / 8) > 0.95);
+    BOOST_CHECK(HitRate(set, hashesNew, hashesNew.size()) > 0.95);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+// Copyright (c) 2014-2017 The Terracoin Core developers
+
+#include "governance.h"
+
+#include "test/test_terracoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_tests, BasicTestingSetup)
+
+static const uint256 nObjectHash = uint256S("0x1234");
+
+static CGovernanceVote MakeVote(uint32_t n, int64_t nTime)
+{
+    CGovernanceVote vote(CTxIn(COutPoint(uint256S("0xabcd"), n)), nObjectHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    vote.SetTime(nTime);
+    return vote;
+}
+
+static CGovernanceObjectVoteSummary MakeSummary(const std::vector<CGovernanceVote>& vecVotes)
+{
+    CGovernanceObjectVoteSummary summary;
+    summary.nObjectHash = nObjectHash;
+    std::set<uint256> setHashes;
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        setHashes.insert(vecVotes[i].GetHash());
+        summary.nLastVoteTime = std::max(summary.nLastVoteTime, vecVotes[i].GetTimestamp());
+    }
+    summary.nVoteCount = setHashes.size();
+    summary.hashVoteSet = CGovernanceObjectVoteFile::GetVoteSetHash(setHashes);
+    return summary;
+}
+
+BOOST_AUTO_TEST_CASE(governance_missing_votes_test)
+{
+    const CGovernanceVote voteA = MakeVote(0, 1000);
+    const CGovernanceVote voteB = MakeVote(1, 2000);
+    const CGovernanceVote voteC = MakeVote(2, 2000);
+    const CGovernanceVote voteD = MakeVote(3, 3000);
+
+    std::vector<CGovernanceVote> vecOurs;
+    vecOurs.push_back(voteA);
+    vecOurs.push_back(voteB);
+    vecOurs.push_back(voteD);
+
+    std::vector<CGovernanceVote> vecMissing;
+
+    // same votes, nothing is missing
+    BOOST_CHECK(CGovernanceManager::GetMissingVotes(vecOurs, MakeSummary(vecOurs), vecMissing));
+    BOOST_CHECK(vecMissing.empty());
+
+    // the peer has our older votes, it misses the newest one only
+    std::vector<CGovernanceVote> vecPeer;
+    vecPeer.push_back(voteA);
+    vecPeer.push_back(voteB);
+    BOOST_CHECK(CGovernanceManager::GetMissingVotes(vecOurs, MakeSummary(vecPeer), vecMissing));
+    BOOST_CHECK(vecMissing.size() == 1 && vecMissing[0].GetHash() == voteD.GetHash());
+
+    // the peer has no votes at all
+    vecPeer.clear();
+    BOOST_CHECK(CGovernanceManager::GetMissingVotes(vecOurs, MakeSummary(vecPeer), vecMissing));
+    BOOST_CHECK(vecMissing.size() == 3);
+
+    // equal counts and last vote times, but different votes: the peer misses voteB,
+    // which the summary can't tell
+    std::vector<CGovernanceVote> vecOursEqual;
+    vecOursEqual.push_back(voteA);
+    vecOursEqual.push_back(voteB);
+    vecPeer.push_back(voteA);
+    vecPeer.push_back(voteC);
+    CGovernanceObjectVoteSummary summary = MakeSummary(vecPeer);
+    BOOST_CHECK(summary.nVoteCount == 2 && summary.nLastVoteTime == voteB.GetTimestamp());
+    BOOST_CHECK(!CGovernanceManager::GetMissingVotes(vecOursEqual, summary, vecMissing));
+    BOOST_CHECK(vecMissing.empty());
+
+    // the peer has a vote we don't know next to older votes we miss, the newer
+    // votes aren't all it misses
+    BOOST_CHECK(!CGovernanceManager::GetMissingVotes(vecOurs, summary, vecMissing));
+    BOOST_CHECK(vecMissing.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -188,4 +188,48 @@ BOOST_AUTO_TEST_CASE(key_test1)
     BOOST_CHECK(detsigc == ParseHex("2052d8a32079c11e79db95af63bb9600c5b04f21a9ca33dc129c2bfa8ac9dc1cd561d8ae5e0f6c1a16bde3719c64c2fd70e404b6428ab9a69566962e8771b5944d"));
 }
 
+BOOST_AUTO_TEST_CASE(signature_batch)
+{
+    CBitcoinSecret bsecret1, bsecret1C;
+    BOOST_CHECK(bsecret1.SetString (strSecret1));
+    BOOST_CHECK(bsecret1C.SetString(strSecret1C));
+    CKey key1  = bsecret1.GetKey();
+    CKey key1C = bsecret1C.GetKey();
+
+    CSignatureBatch batch;
+    std::vector<bool> vValid;
+    BOOST_CHECK(batch.Verify(vValid));
+    BOOST_CHECK(vValid.empty());
+
+    for (int n=0; n<8; n++)
+    {
+        uint256 hashMsg = Hash(BEGIN(n), END(n));
+        std::vector<unsigned char> sig, sigC;
+        BOOST_CHECK(key1.Sign(hashMsg, sig));
+        BOOST_CHECK(key1C.Sign(hashMsg, sigC));
+        batch.Add(hashMsg, sig, key1.GetPubKey());
+        batch.Add(hashMsg, sigC, key1C.GetPubKey());
+    }
+    BOOST_CHECK(batch.Verify(vValid));
+    BOOST_CHECK_EQUAL(vValid.size(), 16U);
+
+    // A signature by the wrong key, and an invalid public key, are reported individually
+    std::vector<unsigned char> sig;
+    uint256 hashMsg = Hash(strSecret1.begin(), strSecret1.end());
+    BOOST_CHECK(key1C.Sign(hashMsg, sig));
+    batch.Add(hashMsg, sig, key1.GetPubKey());
+    batch.Add(hashMsg, sig, CPubKey());
+    batch.Add(hashMsg, sig, key1C.GetPubKey());
+    BOOST_CHECK(!batch.Verify(vValid));
+    BOOST_CHECK_EQUAL(vValid.size(), 19U);
+    for (unsigned int i = 0; i < 16; i++)
+        BOOST_CHECK(vValid[i]);
+    BOOST_CHECK(!vValid[16]);
+    BOOST_CHECK(!vValid[17]);
+    BOOST_CHECK(vValid[18]);
+
+    batch.clear();
+    BOOST_CHECK_EQUAL(batch.size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,8 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "clientversion.h"
+#include "streams.h"
 #include "txmempool.h"
 #include "util.h"
 
@@ -473,4 +475,43 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSnapshotTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+
+    // A chain of five transactions, each spending the previous one
+    std::vector<CMutableTransaction> vtx(5);
+    for (unsigned int i = 0; i < vtx.size(); i++) {
+        vtx[i].vin.resize(1);
+        vtx[i].vin[0].scriptSig = CScript() << OP_11;
+        if (i > 0)
+            vtx[i].vin[0].prevout = COutPoint(vtx[i - 1].GetHash(), 0);
+        vtx[i].vout.resize(1);
+        vtx[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        vtx[i].vout[0].nValue = 10000LL - i;
+        pool.addUnchecked(vtx[i].GetHash(), entry.Time(100 + i).FromTx(vtx[i]));
+    }
+    pool.PrioritiseTransaction(vtx[2].GetHash(), vtx[2].GetHash().ToString(), 1.0, 500LL);
+
+    CTxMemPoolSnapshot snapshot;
+    pool.GetSnapshot(snapshot);
+
+    // Serialization round trip, as done for mempool.dat
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << snapshot;
+    CTxMemPoolSnapshot snapshotLoaded;
+    ss >> snapshotLoaded;
+
+    // Every transaction must come after its parent and keep its entry time
+    BOOST_CHECK_EQUAL(snapshotLoaded.vTxAndTime.size(), vtx.size());
+    for (unsigned int i = 0; i < snapshotLoaded.vTxAndTime.size(); i++) {
+        BOOST_CHECK(snapshotLoaded.vTxAndTime[i].first.GetHash() == vtx[i].GetHash());
+        BOOST_CHECK_EQUAL(snapshotLoaded.vTxAndTime[i].second, 100 + i);
+    }
+
+    BOOST_CHECK_EQUAL(snapshotLoaded.mapDeltas.size(), 1);
+    BOOST_CHECK_EQUAL(snapshotLoaded.mapDeltas[vtx[2].GetHash()].second, 500LL);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -133,4 +133,37 @@ BOOST_AUTO_TEST_CASE(merkle_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(merkle_cache_test)
+{
+    CBlock block;
+    block.vtx.resize(5);
+    for (int j = 0; j < 5; j++) {
+        CMutableTransaction mtx;
+        mtx.nLockTime = j;
+        block.vtx[j] = mtx;
+    }
+    uint256 root = BlockMerkleRoot(block);
+    BOOST_CHECK(block.fMerkleRootCached);
+    BOOST_CHECK(BlockMerkleRoot(block) == root);
+    BOOST_CHECK_EQUAL(block.GetSerializeSizeCached(SER_NETWORK, PROTOCOL_VERSION), ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+
+    // Replacing a transaction must invalidate the cached root and size
+    CMutableTransaction mtx;
+    mtx.nLockTime = 5;
+    mtx.vout.resize(1);
+    block.vtx[2] = mtx;
+    BOOST_CHECK(BlockMerkleRoot(block) != root);
+    std::vector<uint256> leaves;
+    for (size_t j = 0; j < block.vtx.size(); j++)
+        leaves.push_back(block.vtx[j].GetHash());
+    BOOST_CHECK(BlockMerkleRoot(block) == ComputeMerkleRoot(leaves));
+    BOOST_CHECK_EQUAL(block.GetSerializeSizeCached(SER_NETWORK, PROTOCOL_VERSION), ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+
+    // So must removing one
+    block.vtx.pop_back();
+    leaves.pop_back();
+    BOOST_CHECK(BlockMerkleRoot(block) == ComputeMerkleRoot(leaves));
+    BOOST_CHECK_EQUAL(block.GetSerializeSizeCached(SER_NETWORK, PROTOCOL_VERSION), ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -72,6 +72,108 @@ bool TestSequenceLocks(const CTransaction &tx, int flags)
     return CheckSequenceLocks(tx, flags);
 }
 
+// Add a transaction the way AcceptToMemoryPool does, so the template cache is told about it
+static void AcceptToPool(CMutableTransaction& tx, TestMemPoolEntryHelper& entry)
+{
+    LOCK(mempool.cs);
+    mempool.addUnchecked(tx.GetHash(), entry.FromTx(tx));
+    mempool.NotifyEntryAccepted(tx);
+}
+
+// The next template, incremental or not, must be valid and select the same
+// transactions as a template built from scratch
+static void CheckTemplateMatchesRebuild(const CChainParams& chainparams, const CScript& scriptPubKey)
+{
+    CBlockTemplate *pblocktemplate, *pblocktemplateFull;
+    BOOST_REQUIRE(pblocktemplate = CreateNewBlock(chainparams, scriptPubKey));
+    CValidationState state;
+    BOOST_CHECK(TestBlockValidity(state, chainparams, pblocktemplate->block, chainActive.Tip(), false, false));
+
+    ResetBlockTemplateCache();
+    BOOST_REQUIRE(pblocktemplateFull = CreateNewBlock(chainparams, scriptPubKey));
+
+    const CBlock& block = pblocktemplate->block;
+    const CBlock& blockFull = pblocktemplateFull->block;
+    BOOST_CHECK_EQUAL(block.vtx.size(), blockFull.vtx.size());
+    std::set<uint256> setTx, setTxFull;
+    for (unsigned int i = 1; i < block.vtx.size(); ++i)
+        setTx.insert(block.vtx[i].GetHash());
+    for (unsigned int i = 1; i < blockFull.vtx.size(); ++i)
+        setTxFull.insert(blockFull.vtx[i].GetHash());
+    BOOST_CHECK(setTx == setTxFull);
+    BOOST_CHECK_EQUAL(block.vtx[0].vout[0].nValue, blockFull.vtx[0].vout[0].nValue);
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], pblocktemplateFull->vTxFees[0]);
+
+    delete pblocktemplate;
+    delete pblocktemplateFull;
+}
+
+// Templates built from the cached selection after the mempool changed
+static void TestIncrementalTemplates(const CChainParams& chainparams, const CScript& scriptPubKey, const std::vector<CTransaction*>& txFirst)
+{
+    TestMemPoolEntryHelper entry;
+    entry.nHeight = 11;
+
+    // Room for two of the padded transactions below, and no priority area
+    mapArgs["-blockmaxsize"] = "2000";
+    mapArgs["-blockprioritysize"] = "0";
+    mapArgs["-blockminsize"] = "0";
+
+    std::vector<unsigned char> vchData(300);
+    std::vector<CMutableTransaction> vtx(4);
+    CAmount vFees[] = {10000, 20000, 50000, 5000};
+    for (unsigned int i = 0; i < vtx.size(); ++i) {
+        vtx[i].vin.resize(1);
+        vtx[i].vin[0].prevout = COutPoint(txFirst[i]->GetHash(), 0);
+        vtx[i].vin[0].scriptSig = CScript() << vchData << OP_DROP << OP_1;
+        vtx[i].vout.resize(1);
+        vtx[i].vout[0].nValue = txFirst[i]->vout[0].nValue - vFees[i];
+        vtx[i].vout[0].scriptPubKey = CScript() << OP_1;
+    }
+
+    AcceptToPool(vtx[0], entry.Fee(vFees[0]).Time(GetTime()).SpendsCoinbase(true));
+    CheckTemplateMatchesRebuild(chainparams, scriptPubKey);
+
+    // accepted transaction appended to the selection
+    AcceptToPool(vtx[1], entry.Fee(vFees[1]).Time(GetTime()).SpendsCoinbase(true));
+    CheckTemplateMatchesRebuild(chainparams, scriptPubKey);
+
+    // the block is full, a better paying transaction displaces the cheapest one
+    AcceptToPool(vtx[2], entry.Fee(vFees[2]).Time(GetTime()).SpendsCoinbase(true));
+    CheckTemplateMatchesRebuild(chainparams, scriptPubKey);
+
+    // a worse paying transaction doesn't fit anymore
+    AcceptToPool(vtx[3], entry.Fee(vFees[3]).Time(GetTime()).SpendsCoinbase(true));
+    CheckTemplateMatchesRebuild(chainparams, scriptPubKey);
+
+    // a child whose parent was left out is left out too, however well it pays
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].prevout = COutPoint(vtx[3].GetHash(), 0);
+    txChild.vin[0].scriptSig = CScript() << OP_1;
+    txChild.vout.resize(1);
+    txChild.vout[0].nValue = vtx[3].vout[0].nValue - 100000;
+    txChild.vout[0].scriptPubKey = CScript() << OP_1;
+    AcceptToPool(txChild, entry.Fee(100000).Time(GetTime()).SpendsCoinbase(false));
+    CheckTemplateMatchesRebuild(chainparams, scriptPubKey);
+
+    // prioritising the parent pulls it and its child into the block
+    mempool.PrioritiseTransaction(vtx[3].GetHash(), vtx[3].GetHash().ToString(), 0, 1000000);
+    CheckTemplateMatchesRebuild(chainparams, scriptPubKey);
+
+    // a selected transaction leaving the pool takes its child with it
+    std::list<CTransaction> removed;
+    mempool.remove(vtx[3], removed, true);
+    BOOST_CHECK_EQUAL(removed.size(), 2U);
+    CheckTemplateMatchesRebuild(chainparams, scriptPubKey);
+
+    mempool.ClearPrioritisation(vtx[3].GetHash());
+    mapArgs.erase("-blockmaxsize");
+    mapArgs.erase("-blockprioritysize");
+    mapArgs.erase("-blockminsize");
+    mempool.clear();
+}
+
 // NOTE: These tests rely on CreateNewBlock doing its own self-validation!
 BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
 {
@@ -128,6 +230,8 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     BOOST_CHECK(pblocktemplate = CreateNewBlock(chainparams, scriptPubKey));
     delete pblocktemplate;
 
+    TestIncrementalTemplates(chainparams, scriptPubKey, txFirst);
+
     // block sigops > limit: 1000 CHECKMULTISIG + 1
     tx.vin.resize(1);
     // NOTE: OP_NOP is used to force 20 SigOps for the CHECKMULTISIG
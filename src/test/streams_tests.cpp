@@ -64,4 +64,27 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));  
 }         
 
+BOOST_AUTO_TEST_CASE(streams_memory_reader)
+{
+    CDataStream ds(SER_DISK, CLIENT_VERSION);
+    std::vector<unsigned char> vch(300, 0x5a);
+    ds << (uint32_t)0xdeadbeef << vch << std::string("terracoin");
+
+    std::vector<char> buf(ds.begin(), ds.end());
+    CMemoryReader reader(&buf[0], buf.size(), SER_DISK, CLIENT_VERSION);
+    uint32_t n;
+    std::vector<unsigned char> vchRead;
+    std::string str;
+    reader >> n >> vchRead >> str;
+    BOOST_CHECK_EQUAL(n, 0xdeadbeef);
+    BOOST_CHECK(vchRead == vch);
+    BOOST_CHECK_EQUAL(str, "terracoin");
+    BOOST_CHECK_EQUAL(reader.size(), 0U);
+
+    // Reading past the end of the range must fail, not run off the buffer
+    CMemoryReader truncated(&buf[0], buf.size() - 1, SER_DISK, CLIENT_VERSION);
+    truncated >> n >> vchRead;
+    BOOST_CHECK_THROW(truncated >> str, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
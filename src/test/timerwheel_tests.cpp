@@ -0,0 +1,104 @@
+// Copyright (c) 2014-2017 The Terracoin Core developers
+
+#include "timerwheel.h"
+
+#include "test/test_terracoin.h"
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(timerwheel_tests, BasicTestingSetup)
+
+static std::vector<int> AdvanceSorted(TimerWheel<int>& wheel, int64_t nNow)
+{
+    std::vector<int> vecDue;
+    wheel.Advance(nNow, vecDue);
+    std::sort(vecDue.begin(), vecDue.end());
+    return vecDue;
+}
+
+BOOST_AUTO_TEST_CASE(timerwheel_test)
+{
+    TimerWheel<int> wheel(60);
+    const int64_t nStart = 1500000000;
+
+    // start the wheel
+    BOOST_CHECK(AdvanceSorted(wheel, nStart).empty());
+
+    wheel.Schedule(1, nStart + 30);
+    wheel.Schedule(2, nStart + 600);
+    wheel.Schedule(3, nStart + 60 * 60 * 3);
+    wheel.Schedule(4, nStart + 60 * 60 * 24 * 30);
+    BOOST_CHECK(wheel.GetSize() == 4);
+    BOOST_CHECK(wheel.HasKey(3));
+
+    // nothing is due early
+    BOOST_CHECK(AdvanceSorted(wheel, nStart + 29).empty());
+
+    std::vector<int> vecDue = AdvanceSorted(wheel, nStart + 120);
+    BOOST_CHECK(vecDue.size() == 1 && vecDue[0] == 1);
+    BOOST_CHECK(!wheel.HasKey(1));
+
+    // rescheduling replaces the previous time
+    wheel.Schedule(2, nStart + 60 * 60);
+    BOOST_CHECK(AdvanceSorted(wheel, nStart + 900).empty());
+
+    // cancelled keys are never returned
+    wheel.Cancel(3);
+    BOOST_CHECK(!wheel.HasKey(3));
+
+    // turn the wheel tick by tick through several level 0 turns
+    vecDue.clear();
+    for(int64_t nNow = nStart + 900; nNow <= nStart + 60 * 60 * 4; nNow += 300) {
+        std::vector<int> vecStep = AdvanceSorted(wheel, nNow);
+        vecDue.insert(vecDue.end(), vecStep.begin(), vecStep.end());
+    }
+    BOOST_CHECK(vecDue.size() == 1 && vecDue[0] == 2);
+    BOOST_CHECK(wheel.GetSize() == 1);
+
+    // keys scheduled in the past are returned by the next call
+    wheel.Schedule(5, nStart);
+    vecDue = AdvanceSorted(wheel, nStart + 60 * 60 * 4);
+    BOOST_CHECK(vecDue.size() == 1 && vecDue[0] == 5);
+
+    // a big step moves all keys due by then at once
+    wheel.Schedule(6, nStart + 60 * 60 * 24 * 31);
+    vecDue = AdvanceSorted(wheel, nStart + 60 * 60 * 24 * 30 + 59);
+    BOOST_CHECK(vecDue.size() == 1 && vecDue[0] == 4);
+    vecDue = AdvanceSorted(wheel, nStart + 60 * 60 * 24 * 31);
+    BOOST_CHECK(vecDue.size() == 1 && vecDue[0] == 6);
+    BOOST_CHECK(wheel.GetSize() == 0);
+
+    wheel.Schedule(7, nStart);
+    wheel.Clear();
+    BOOST_CHECK(wheel.GetSize() == 0);
+    BOOST_CHECK(AdvanceSorted(wheel, nStart + 60 * 60 * 24 * 40).empty());
+}
+
+BOOST_AUTO_TEST_CASE(timerwheel_cascade_test)
+{
+    // every key is returned exactly once, in the tick of its time
+    TimerWheel<int> wheel(1);
+    const int64_t nStart = 1000;
+    BOOST_CHECK(AdvanceSorted(wheel, nStart).empty());
+
+    const int nKeys = 5000;
+    for(int i = 0; i < nKeys; ++i) {
+        wheel.Schedule(i, nStart + 1 + (int64_t(i) * 7919) % 300000);
+    }
+
+    std::vector<int> vecSeen(nKeys, 0);
+    for(int64_t nNow = nStart + 1; nNow <= nStart + 300000; ++nNow) {
+        std::vector<int> vecDue;
+        wheel.Advance(nNow, vecDue);
+        for(size_t j = 0; j < vecDue.size(); ++j) {
+            BOOST_CHECK(nStart + 1 + (int64_t(vecDue[j]) * 7919) % 300000 == nNow);
+            ++vecSeen[vecDue[j]];
+        }
+    }
+    BOOST_CHECK(std::count(vecSeen.begin(), vecSeen.end(), 1) == nKeys);
+    BOOST_CHECK(wheel.GetSize() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
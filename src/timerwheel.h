@@ -0,0 +1,202 @@
+// Copyright (c) 2014-2017 The Terracoin Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+#include <stdint.h>
+
+/**
+ * Hierarchical timer wheel
+ *
+ * Keys are scheduled at a time and returned by Advance() once that time has
+ * passed, without looking at keys which are not due yet. Time is counted in
+ * ticks of nTickSeconds: level 0 has a slot per tick, every level above it a
+ * slot per full turn of the level below. Keys move down a level when their
+ * slot comes up, so each key is touched at most once per level. Keys are
+ * never returned early, but up to one tick late.
+ *
+ * A key has at most one pending time, scheduling it again replaces the time
+ * and Cancel() removes it. Replaced and cancelled entries are dropped when
+ * their slot comes up.
+ */
+template<typename K>
+class TimerWheel
+{
+public:
+    static const int SLOT_BITS = 6;
+
+    static const int64_t SLOT_COUNT = 1 << SLOT_BITS;
+
+    static const int LEVEL_COUNT = 4;
+
+private:
+    typedef std::pair<K, int64_t> entry_t;
+
+    typedef std::vector<entry_t> slot_t;
+
+    typedef std::map<K, int64_t> tick_m_t;
+
+    typedef typename tick_m_t::iterator tick_m_it;
+
+    typedef std::multimap<int64_t, K> behind_m_t;
+
+    int64_t nTickSeconds;
+
+    /// Last tick handled by Advance(), -1 until the wheel is used
+    int64_t nCurrentTick;
+
+    /// Pending tick of every scheduled key
+    tick_m_t mapTicks;
+
+    /// Slots of all levels, level by level
+    std::vector<slot_t> vecSlots;
+
+    /// Keys scheduled at or before nCurrentTick, e.g. after the clock went back
+    behind_m_t mapBehind;
+
+public:
+    TimerWheel(int64_t nTickSecondsIn = 60)
+        : nTickSeconds(nTickSecondsIn),
+          nCurrentTick(-1),
+          mapTicks(),
+          vecSlots(LEVEL_COUNT * SLOT_COUNT),
+          mapBehind()
+    {}
+
+    void Clear()
+    {
+        nCurrentTick = -1;
+        mapTicks.clear();
+        vecSlots.assign(LEVEL_COUNT * SLOT_COUNT, slot_t());
+        mapBehind.clear();
+    }
+
+    size_t GetSize() const {
+        return mapTicks.size();
+    }
+
+    bool HasKey(const K& key) const
+    {
+        return mapTicks.count(key) > 0;
+    }
+
+    void Schedule(const K& key, int64_t nTime)
+    {
+        // round up so that keys are never returned before nTime
+        int64_t nTick = (nTime + nTickSeconds - 1) / nTickSeconds;
+        if(nCurrentTick < 0) {
+            nCurrentTick = nTick - 1;
+        }
+        mapTicks[key] = nTick;
+        if(nTick <= nCurrentTick) {
+            mapBehind.insert(std::make_pair(nTick, key));
+            return;
+        }
+        Insert(entry_t(key, nTick));
+    }
+
+    void Cancel(const K& key)
+    {
+        mapTicks.erase(key);
+    }
+
+    /**
+     * Move the wheel to nNow and append the keys due by then to vecDue
+     */
+    void Advance(int64_t nNow, std::vector<K>& vecDue)
+    {
+        int64_t nTargetTick = nNow / nTickSeconds;
+        if(nCurrentTick < 0) {
+            nCurrentTick = nTargetTick;
+        }
+
+        typename behind_m_t::iterator itBehind = mapBehind.begin();
+        while(itBehind != mapBehind.end() && itBehind->first <= nTargetTick) {
+            Fire(entry_t(itBehind->second, itBehind->first), vecDue);
+            mapBehind.erase(itBehind++);
+        }
+
+        if(nTargetTick - nCurrentTick > SLOT_COUNT) {
+            // too far to turn the wheel tick by tick (node was asleep, clock jumped), start over
+            Rebuild(nTargetTick, vecDue);
+            return;
+        }
+
+        while(nCurrentTick < nTargetTick) {
+            ++nCurrentTick;
+            // move keys down from the levels which start a new slot with this tick, top level first
+            for(int nLevel = LEVEL_COUNT - 1; nLevel > 0; --nLevel) {
+                if((nCurrentTick & ((int64_t(1) << (SLOT_BITS * nLevel)) - 1)) != 0) continue;
+                slot_t slot;
+                slot.swap(GetSlot(nLevel, nCurrentTick));
+                for(size_t i = 0; i < slot.size(); ++i) {
+                    if(IsPending(slot[i])) {
+                        Insert(slot[i]);
+                    }
+                }
+            }
+            slot_t slot;
+            slot.swap(GetSlot(0, nCurrentTick));
+            for(size_t i = 0; i < slot.size(); ++i) {
+                Fire(slot[i], vecDue);
+            }
+        }
+    }
+
+private:
+    slot_t& GetSlot(int nLevel, int64_t nTick)
+    {
+        return vecSlots[nLevel * SLOT_COUNT + ((nTick >> (SLOT_BITS * nLevel)) & (SLOT_COUNT - 1))];
+    }
+
+    bool IsPending(const entry_t& entry) const
+    {
+        typename tick_m_t::const_iterator it = mapTicks.find(entry.first);
+        return (it != mapTicks.end()) && (it->second == entry.second);
+    }
+
+    void Fire(const entry_t& entry, std::vector<K>& vecDue)
+    {
+        if(!IsPending(entry)) {
+            return;
+        }
+        mapTicks.erase(entry.first);
+        vecDue.push_back(entry.first);
+    }
+
+    /// Put an entry into the lowest level whose slots still cover its tick
+    void Insert(const entry_t& entry)
+    {
+        int nLevel = 0;
+        while(nLevel < LEVEL_COUNT - 1 &&
+              (entry.second >> (SLOT_BITS * (nLevel + 1))) != (nCurrentTick >> (SLOT_BITS * (nLevel + 1)))) {
+            ++nLevel;
+        }
+        GetSlot(nLevel, entry.second).push_back(entry);
+    }
+
+    void Rebuild(int64_t nTargetTick, std::vector<K>& vecDue)
+    {
+        vecSlots.assign(LEVEL_COUNT * SLOT_COUNT, slot_t());
+        nCurrentTick = nTargetTick;
+        tick_m_it it = mapTicks.begin();
+        while(it != mapTicks.end()) {
+            if(it->second <= nTargetTick) {
+                vecDue.push_back(it->first);
+                mapTicks.erase(it++);
+                continue;
+            }
+            Insert(entry_t(it->first, it->second));
+            ++it;
+        }
+    }
+};
+
+#endif /* TIMERWHEEL_H_ */
@@ -23,11 +23,13 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCEINDEX = 'w';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_ADDRESSBALANCE_BEST_BLOCK = 'W';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
@@ -235,13 +237,34 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
     return WriteBatch(batch);
 }
 
+namespace {
+struct CAddressIndexCollector {
+    std::vector<std::pair<CAddressIndexKey, CAmount> >& vect;
+    CAddressIndexCollector(std::vector<std::pair<CAddressIndexKey, CAmount> >& vectIn) : vect(vectIn) {}
+    bool operator()(const CAddressIndexKey& key, CAmount nValue) {
+        vect.push_back(make_pair(key, nValue));
+        return true;
+    }
+};
+}
+
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
+    if (!(start > 0 && end > 0))
+        start = end = 0;
+    return ScanAddressIndex(addressHash, type, start, end, NULL, CAddressIndexCollector(addressIndex));
+}
+
+bool CBlockTreeDB::ScanAddressIndex(uint160 addressHash, int type, int start, int end,
+                                    const CAddressIndexKey* pkeyAfter,
+                                    const boost::function<bool (const CAddressIndexKey&, CAmount)>& visitor) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pkeyAfter && pkeyAfter->blockHeight >= start) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pkeyAfter));
+    } else if (start > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
@@ -254,9 +277,14 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
+            if (pkeyAfter && key.second == *pkeyAfter) {
+                pcursor->Next();
+                continue;
+            }
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(make_pair(key.second, nValue));
+                if (!visitor(key.second, nValue))
+                    break;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -269,6 +297,121 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance) {
+    // Addresses without any activity have no entry
+    if (!Read(make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), balance))
+        balance.SetNull();
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalanceBestBlock(uint256 &hashBestBlock) {
+    return Read(DB_ADDRESSBALANCE_BEST_BLOCK, hashBestBlock);
+}
+
+static void BatchAddressBalances(CDBBatch &batch, const std::vector<std::pair<std::pair<uint160, int>, CAddressBalanceValue> > &vect) {
+    for (std::vector<std::pair<std::pair<uint160, int>, CAddressBalanceValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        CAddressIndexIteratorKey key(it->first.second, it->first.first);
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSBALANCEINDEX, key));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, key), it->second);
+        }
+    }
+}
+
+bool CBlockTreeDB::WriteAddressBalances(const std::vector<std::pair<std::pair<uint160, int>, CAddressBalanceValue> > &vect, const uint256 &hashBestBlock) {
+    CDBBatch batch(&GetObfuscateKey());
+    BatchAddressBalances(batch, vect);
+    batch.Write(DB_ADDRESSBALANCE_BEST_BLOCK, hashBestBlock);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::RebuildAddressBalanceIndex(int nMaxHeight, const uint256 &hashBestBlock) {
+    // Drop the best block first, an interrupted rebuild is started over at the next startup
+    {
+        CDBBatch batch(&GetObfuscateKey());
+        batch.Erase(DB_ADDRESSBALANCE_BEST_BLOCK);
+        if (!WriteBatch(batch, true))
+            return false;
+    }
+
+    // Null balances are erased
+    std::vector<std::pair<std::pair<uint160, int>, CAddressBalanceValue> > vBalances;
+    {
+        boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(DB_ADDRESSBALANCEINDEX);
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char,CAddressIndexIteratorKey> key;
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESSBALANCEINDEX)
+                break;
+            vBalances.push_back(make_pair(make_pair(key.second.hashBytes, (int)key.second.type), CAddressBalanceValue()));
+            if (vBalances.size() >= 10000) {
+                CDBBatch batch(&GetObfuscateKey());
+                BatchAddressBalances(batch, vBalances);
+                if (!WriteBatch(batch))
+                    return false;
+                vBalances.clear();
+            }
+            pcursor->Next();
+        }
+        CDBBatch batch(&GetObfuscateKey());
+        BatchAddressBalances(batch, vBalances);
+        if (!WriteBatch(batch))
+            return false;
+        vBalances.clear();
+    }
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(DB_ADDRESSINDEX);
+
+    // Entries are sorted by address, and the entries of one transaction are adjacent.
+    // Entries above nMaxHeight belong to blocks that are not part of the chainstate yet.
+    std::pair<uint160, int> address;
+    CAddressBalanceValue balance;
+    uint256 txhashLast;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX)
+            break;
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+
+        std::pair<uint160, int> addressKey(key.second.hashBytes, key.second.type);
+        if (addressKey != address) {
+            if (!balance.IsNull())
+                vBalances.push_back(make_pair(address, balance));
+            if (vBalances.size() >= 10000) {
+                CDBBatch batch(&GetObfuscateKey());
+                BatchAddressBalances(batch, vBalances);
+                if (!WriteBatch(batch))
+                    return false;
+                vBalances.clear();
+            }
+            address = addressKey;
+            balance.SetNull();
+            txhashLast.SetNull();
+        }
+        if (key.second.blockHeight <= nMaxHeight) {
+            if (nValue > 0)
+                balance.received += nValue;
+            balance.balance += nValue;
+            if (key.second.txhash != txhashLast) {
+                balance.nTxCount++;
+                txhashLast = key.second.txhash;
+            }
+        }
+        pcursor->Next();
+    }
+    if (!balance.IsNull())
+        vBalances.push_back(make_pair(address, balance));
+
+    return WriteAddressBalances(vBalances, hashBestBlock);
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(&GetObfuscateKey());
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
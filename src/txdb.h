@@ -14,11 +14,14 @@
 #include <utility>
 #include <vector>
 
+#include <boost/function.hpp>
+
 class CBlockFileInfo;
 class CBlockIndex;
 struct CDiskTxPos;
 struct CAddressUnspentKey;
 struct CAddressUnspentValue;
+struct CAddressBalanceValue;
 struct CAddressIndexKey;
 struct CAddressIndexIteratorKey;
 struct CAddressIndexIteratorHeightKey;
@@ -76,6 +79,21 @@ public:
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    /**
+     * Pass the address index entries of one address to visitor in key order,
+     * without collecting them first. Only heights in [start, end] are visited
+     * (0 = unbounded). If pkeyAfter is given, the scan resumes after that key.
+     * The scan stops early when visitor returns false.
+     */
+    bool ScanAddressIndex(uint160 addressHash, int type, int start, int end,
+                          const CAddressIndexKey* pkeyAfter,
+                          const boost::function<bool (const CAddressIndexKey&, CAmount)>& visitor);
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance);
+    bool ReadAddressBalanceBestBlock(uint256 &hashBestBlock);
+    /** Write balances together with the block they are at */
+    bool WriteAddressBalances(const std::vector<std::pair<std::pair<uint160, int>, CAddressBalanceValue> > &vect, const uint256 &hashBestBlock);
+    /** Recompute every address balance from the address index entries up to nMaxHeight */
+    bool RebuildAddressBalanceIndex(int nMaxHeight, const uint256 &hashBestBlock);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
@@ -17,6 +17,8 @@
 #include "utiltime.h"
 #include "version.h"
 
+#include <sstream>
+
 using namespace std;
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
@@ -564,6 +566,7 @@ bool CTxMemPool::removeSpentIndex(const uint256 txhash)
 void CTxMemPool::removeUnchecked(txiter it)
 {
     const uint256 hash = it->GetTx().GetHash();
+    NotifyEntryRemoved(it->GetTx());
     BOOST_FOREACH(const CTxIn& txin, it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
 
@@ -855,6 +858,41 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     assert(innerUsage == cachedInnerUsage);
 }
 
+void CTxMemPool::GetSnapshot(CTxMemPoolSnapshot& snapshot) const
+{
+    snapshot.Clear();
+
+    LOCK(cs);
+    snapshot.vTxAndTime.reserve(mapTx.size());
+    snapshot.mapDeltas = mapDeltas;
+
+    // Depth-first over in-mempool parents, so every transaction is preceded
+    // by all of its ancestors
+    std::set<uint256> setDone;
+    std::vector<std::pair<txiter, bool> > vStack;
+    for (txiter it = mapTx.begin(); it != mapTx.end(); ++it) {
+        vStack.push_back(std::make_pair(it, false));
+        while (!vStack.empty()) {
+            txiter entry = vStack.back().first;
+            bool fParentsDone = vStack.back().second;
+            vStack.pop_back();
+            const uint256& hash = entry->GetTx().GetHash();
+            if (setDone.count(hash))
+                continue;
+            if (fParentsDone) {
+                setDone.insert(hash);
+                snapshot.vTxAndTime.push_back(std::make_pair(entry->GetTx(), entry->GetTime()));
+                continue;
+            }
+            vStack.push_back(std::make_pair(entry, true));
+            BOOST_FOREACH(txiter parent, GetMemPoolParents(entry)) {
+                if (!setDone.count(parent->GetTx().GetHash()))
+                    vStack.push_back(std::make_pair(parent, false));
+            }
+        }
+    }
+}
+
 void CTxMemPool::queryHashes(vector<uint256>& vtxid)
 {
     vtxid.clear();
@@ -937,6 +975,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const string strHash,
         std::pair<double, CAmount> &deltas = mapDeltas[hash];
         deltas.first += dPriorityDelta;
         deltas.second += nFeeDelta;
+        nTransactionsUpdated++;
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(deltas.second));
@@ -1148,3 +1187,17 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<uint256>* pvNoSpendsRe
     if (maxFeeRateRemoved > CFeeRate(0))
         LogPrint("mempool", "Removed %u txn, rolling minimum fee bumped to %s\n", nTxnRemoved, maxFeeRateRemoved.ToString());
 }
+
+void CTxMemPoolSnapshot::Clear()
+{
+    vTxAndTime.clear();
+    mapDeltas.clear();
+}
+
+std::string CTxMemPoolSnapshot::ToString() const
+{
+    std::ostringstream info;
+    info << "Transactions: " << (int)vTxAndTime.size() <<
+            ", fee deltas: " << (int)mapDeltas.size();
+    return info.str();
+}
@@ -20,8 +20,11 @@
 #include "boost/multi_index_container.hpp"
 #include "boost/multi_index/ordered_index.hpp"
 
+#include <boost/signals2/signal.hpp>
+
 class CAutoFile;
 class CBlockIndex;
+class CTxMemPoolSnapshot;
 
 inline double AllowFreeThreshold()
 {
@@ -441,6 +444,11 @@ public:
     std::map<COutPoint, CInPoint> mapNextTx;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
 
+    /** Fired by AcceptToMemoryPool once a fully validated transaction was added */
+    boost::signals2::signal<void (const CTransaction &)> NotifyEntryAccepted;
+    /** Fired for every transaction leaving the pool, before it is erased */
+    boost::signals2::signal<void (const CTransaction &)> NotifyEntryRemoved;
+
     /** Create a new CTxMemPool.
      *  minReasonableRelayFee should be a feerate which is, roughly, somewhere
      *  around what it "costs" to relay a transaction around the network and
@@ -496,6 +504,9 @@ public:
     void ApplyDeltas(const uint256 hash, double &dPriorityDelta, CAmount &nFeeDelta) const;
     void ClearPrioritisation(const uint256 hash);
 
+    /** Copy all transactions (parents before children) and fee deltas into a snapshot */
+    void GetSnapshot(CTxMemPoolSnapshot& snapshot) const;
+
 public:
     /** Remove a set of transactions from the mempool.
      *  If a transaction is in this set, then all in-mempool descendants must
@@ -630,6 +641,30 @@ private:
     void removeUnchecked(txiter entry);
 };
 
+/**
+ * Serializable copy of the memory pool, dumped to mempool.dat on shutdown
+ * and re-accepted on startup. Transactions are stored parents first so
+ * that they can be accepted back in a single pass.
+ */
+class CTxMemPoolSnapshot
+{
+public:
+    std::vector<std::pair<CTransaction, int64_t> > vTxAndTime;
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(vTxAndTime);
+        READWRITE(mapDeltas);
+    }
+
+    void Clear();
+    void CheckAndRemove() {}
+    std::string ToString() const;
+};
+
 /** 
  * CCoinsView that brings transactions from a memorypool into view.
  * It does not check for spendings by memory pool transactions.